@@ -51,6 +51,10 @@
 /*- Definitions ------------------------------------------------------------*/
 #define TIMER_PRESCALER     8
 
+#if HAL_TIMER_INTERVAL < 1 || ((F_CPU / 1000ul) / TIMER_PRESCALER) * HAL_TIMER_INTERVAL > 0xffff
+  #error HAL_TIMER_INTERVAL does not fit into the timer compare register
+#endif
+
 /*- Variables --------------------------------------------------------------*/
 volatile uint8_t halTimerIrqCount;
 
@@ -55,6 +55,7 @@
 #include "nwkGroup.h"
 #include "nwkSecurity.h"
 #include "nwkDataReq.h"
+#include "nwkFrag.h"
 
 /*- Definitions ------------------------------------------------------------*/
 #define NWK_MAX_PAYLOAD_SIZE            (127 - 16/*NwkFrameHeader_t*/ - 2/*crc*/)
@@ -65,6 +66,25 @@
 #define NWK_ENDPOINTS_AMOUNT            16
 
 /*- Types ------------------------------------------------------------------*/
+enum
+{
+  NWK_BUFFER_CLASS_RX          = 0,
+  NWK_BUFFER_CLASS_REBROADCAST = 1,
+  NWK_BUFFER_CLASS_DATA        = 2,
+  NWK_BUFFER_CLASS_CONTROL     = 3,
+  NWK_BUFFER_CLASSES_AMOUNT,
+};
+
+enum
+{
+  NWK_RX_DROP_INVALID          = 0,
+  NWK_RX_DROP_FOREIGN_PAN      = 1,
+  NWK_RX_DROP_OWN_FRAME        = 2,
+  NWK_RX_DROP_NOT_FOR_US       = 3,
+  NWK_RX_DROP_NO_BUFFER        = 4,
+  NWK_RX_DROP_REASONS_AMOUNT,
+};
+
 typedef enum
 {
   NWK_SUCCESS_STATUS                      = 0x00,
@@ -78,6 +98,20 @@ typedef enum
   NWK_PHY_NO_ACK_STATUS                   = 0x21,
 } NWK_Status_t;
 
+typedef struct NWK_Stats_t
+{
+  uint16_t     allocFailures[NWK_BUFFER_CLASSES_AMOUNT];
+  uint16_t     duplicatesRejected;
+  uint16_t     rxDropped[NWK_RX_DROP_REASONS_AMOUNT];
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+  uint16_t     broadcastsRelayed;
+  uint16_t     broadcastsSuppressed;
+#endif
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  uint16_t     congestionBackoffs;
+#endif
+} NWK_Stats_t;
+
 typedef struct NwkIb_t
 {
   uint16_t     addr;
@@ -89,6 +123,7 @@ typedef struct NwkIb_t
   uint32_t     key[4];
 #endif
   uint16_t     lock;
+  NWK_Stats_t  stats;
 } NwkIb_t;
 
 /*- Variables --------------------------------------------------------------*/
@@ -105,6 +140,8 @@ void NWK_Unlock(void);
 void NWK_SleepReq(void);
 void NWK_WakeupReq(void);
 void NWK_TaskHandler(void);
+NWK_Stats_t *NWK_GetStats(void);
+void NWK_ResetStats(void);
 
 uint8_t NWK_LinearizeLqi(uint8_t lqi);
 
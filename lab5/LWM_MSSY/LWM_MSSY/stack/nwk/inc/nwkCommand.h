@@ -58,6 +58,7 @@ enum
   NWK_COMMAND_ROUTE_ERROR         = 0x01,
   NWK_COMMAND_ROUTE_REQUEST       = 0x02,
   NWK_COMMAND_ROUTE_REPLY         = 0x03,
+  NWK_COMMAND_BLOCK_ACK           = 0x04,
 };
 
 typedef struct PACK NwkCommandAck_t
@@ -67,6 +68,14 @@ typedef struct PACK NwkCommandAck_t
   uint8_t    control;
 } NwkCommandAck_t;
 
+typedef struct PACK NwkCommandBlockAck_t
+{
+  uint8_t    id;
+  uint8_t    seq;
+  uint8_t    mask; // bit N acknowledges (seq - N - 1)
+  uint8_t    control;
+} NwkCommandBlockAck_t;
+
 typedef struct PACK NwkCommandRouteError_t
 {
   uint8_t    id;
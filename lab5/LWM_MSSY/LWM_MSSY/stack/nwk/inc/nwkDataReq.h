@@ -53,7 +53,18 @@
 #include "sysConfig.h"
 #include "sysTypes.h"
 
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_PRIORITY_LEVELS            4
+
 /*- Types ------------------------------------------------------------------*/
+enum
+{
+  NWK_PRIORITY_DATA            = 0,
+  NWK_PRIORITY_ROUTED          = 1,
+  NWK_PRIORITY_ACK             = 2,
+  NWK_PRIORITY_CONTROL         = 3,
+};
+
 enum
 {
   NWK_OPT_ACK_REQUEST          = 1 << 0,
@@ -61,6 +72,7 @@ enum
   NWK_OPT_BROADCAST_PAN_ID     = 1 << 2,
   NWK_OPT_LINK_LOCAL           = 1 << 3,
   NWK_OPT_MULTICAST            = 1 << 4,
+  NWK_OPT_AGGREGATE            = 1 << 5,
 };
 
 typedef struct NWK_DataReq_t
@@ -69,12 +81,14 @@ typedef struct NWK_DataReq_t
   void         *next;
   void         *frame;
   uint8_t      state;
+  uint8_t      round;
 
   // request parameters
   uint16_t     dstAddr;
   uint8_t      dstEndpoint;
   uint8_t      srcEndpoint;
   uint8_t      options;
+  uint8_t      priority;
 #ifdef NWK_ENABLE_MULTICAST
   uint8_t      memberRadius;
   uint8_t      nonMemberRadius;
@@ -86,10 +100,13 @@ typedef struct NWK_DataReq_t
   // confirmation parameters
   uint8_t      status;
   uint8_t      control;
+  uint8_t      attempts;
 } NWK_DataReq_t;
 
 /*- Prototypes -------------------------------------------------------------*/
 void NWK_DataReq(NWK_DataReq_t *req);
+uint8_t *NWK_DataReqAlloc(NWK_DataReq_t *req);
+void NWK_DataReqCommit(NWK_DataReq_t *req);
 
 void nwkDataReqInit(void);
 void nwkDataReqTaskHandler(void);
@@ -0,0 +1,100 @@
+/**
+ * \file nwkFrag.h
+ *
+ * \brief NWK_FragReq() interface
+ *
+ * Copyright (C) 2012-2014, Atmel Corporation. All rights reserved.
+ *
+ * \asf_license_start
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. The name of Atmel may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. This software may only be redistributed and used in connection with an
+ *    Atmel microcontroller product.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * EXPRESSLY AND SPECIFICALLY DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \asf_license_stop
+ *
+ * Modification and other use of this code is subject to Atmel's Limited
+ * License Agreement (license.txt).
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _NWK_FRAG_H_
+#define _NWK_FRAG_H_
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "sysConfig.h"
+#include "sysTypes.h"
+
+#ifdef NWK_ENABLE_FRAGMENTATION
+
+/*- Types ------------------------------------------------------------------*/
+typedef struct NWK_FragReq_t
+{
+  // service fields
+  void         *next;
+  uint8_t      state;
+  uint8_t      tag;
+  uint32_t     startTime;
+
+  // request parameters
+  uint16_t     dstAddr;
+  uint8_t      dstEndpoint;
+  uint8_t      srcEndpoint;
+  uint8_t      options;
+  uint8_t      *data;
+  uint16_t     size;
+  void         (*confirm)(struct NWK_FragReq_t *req);
+
+  // confirmation parameters
+  uint8_t      status;
+  uint16_t     sent;
+  uint32_t     time;
+} NWK_FragReq_t;
+
+typedef struct NWK_FragInd_t
+{
+  uint16_t     srcAddr;
+  uint8_t      srcEndpoint;
+  uint8_t      dstEndpoint;
+  uint8_t      *data;
+  uint16_t     size;
+} NWK_FragInd_t;
+
+/*- Prototypes -------------------------------------------------------------*/
+void NWK_FragReq(NWK_FragReq_t *req);
+void NWK_FragOpenEndpoint(uint8_t id, void (*handler)(NWK_FragInd_t *ind));
+
+void nwkFragInit(void);
+void nwkFragTaskHandler(void);
+
+#endif // NWK_ENABLE_FRAGMENTATION
+
+#endif // _NWK_FRAG_H_
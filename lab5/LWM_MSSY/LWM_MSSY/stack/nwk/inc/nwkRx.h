@@ -49,9 +49,17 @@
 
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
+#include "sysConfig.h"
 #include "sysTypes.h"
 #include "nwkFrame.h"
 
+/*- Definitions ------------------------------------------------------------*/
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+// Set in the acknowledgement control byte by a congested receiver, so
+// applications may only use the lower 7 bits with NWK_SetAckControl()
+#define NWK_ACK_CONTROL_CONGESTED     0x80
+#endif
+
 /*- Types ------------------------------------------------------------------*/
 enum
 {
@@ -79,6 +87,12 @@ typedef struct NWK_DataInd_t
 
 /*- Prototypes -------------------------------------------------------------*/
 void NWK_SetAckControl(uint8_t control);
+void NWK_DataIndDefer(NWK_DataInd_t *ind);
+void NWK_DataIndRelease(NWK_DataInd_t *ind);
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+void NWK_SetCongestionHandler(void (*handler)(bool congested));
+#endif
 
 #ifdef NWK_ENABLE_ADDRESS_FILTER
 bool NWK_FilterAddress(uint16_t addr, uint8_t *lqi);
@@ -73,6 +73,7 @@ void NWK_Init(void)
   nwkIb.macSeqNum = 0;
   nwkIb.addr = 0;
   nwkIb.lock = 0;
+  NWK_ResetStats();
 
   for (uint8_t i = 0; i < NWK_ENDPOINTS_AMOUNT; i++)
     nwkIb.endpoint[i] = NULL;
@@ -97,6 +98,10 @@ void NWK_Init(void)
 #ifdef NWK_ENABLE_ROUTE_DISCOVERY
   nwkRouteDiscoveryInit();
 #endif
+
+#ifdef NWK_ENABLE_FRAGMENTATION
+  nwkFragInit();
+#endif
 }
 
 /*************************************************************************//**
@@ -170,6 +175,23 @@ void NWK_WakeupReq(void)
   PHY_Wakeup();
 }
 
+/*************************************************************************//**
+  @brief Returns network layer statistics collected since the last reset
+  @return Pointer to the statistics
+*****************************************************************************/
+NWK_Stats_t *NWK_GetStats(void)
+{
+  return &nwkIb.stats;
+}
+
+/*************************************************************************//**
+  @brief Clears network layer statistics
+*****************************************************************************/
+void NWK_ResetStats(void)
+{
+  memset(&nwkIb.stats, 0, sizeof(NWK_Stats_t));
+}
+
 /*************************************************************************//**
   @brief Calculates linearized value for the given value of the LQI
   @param[in] lqi LQI value as provided by the transceiver
@@ -201,4 +223,7 @@ void NWK_TaskHandler(void)
 #ifdef NWK_ENABLE_SECURITY
   nwkSecurityTaskHandler();
 #endif
+#ifdef NWK_ENABLE_FRAGMENTATION
+  nwkFragTaskHandler();
+#endif
 }
@@ -50,12 +50,16 @@
 #include <stdbool.h>
 #include <string.h>
 #include "sysConfig.h"
+#include "sysTimer.h"
 #include "nwk.h"
 #include "nwkTx.h"
 #include "nwkFrame.h"
 #include "nwkGroup.h"
 #include "nwkDataReq.h"
 
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_DATA_REQ_AGGREGATION_MAX_SIZE        (NWK_FRAME_MAX_PAYLOAD_SIZE - 2/*crc*/)
+
 /*- Types ------------------------------------------------------------------*/
 enum
 {
@@ -64,11 +68,33 @@ enum
   NWK_DATA_REQ_STATE_CONFIRM,
 };
 
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+typedef struct NwkDataReqBackoffEntry_t
+{
+  uint16_t     dstAddr;
+  bool         used;
+  uint32_t     time;     // when the congested acknowledgement was received
+} NwkDataReqBackoffEntry_t;
+#endif
+
 /*- Prototypes -------------------------------------------------------------*/
+static void nwkDataReqPrepareFrame(NWK_DataReq_t *req, NwkFrame_t *frame);
 static void nwkDataReqTxConf(NwkFrame_t *frame);
+#ifdef NWK_ENABLE_AGGREGATION
+static void nwkDataReqAggregationTimerHandler(SYS_Timer_t *timer);
+#endif
 
 /*- Variables --------------------------------------------------------------*/
 static NWK_DataReq_t *nwkDataReqQueue;
+static NWK_DataReq_t *nwkDataReqQueueTail;
+static uint8_t nwkDataReqRound;
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+static NwkDataReqBackoffEntry_t nwkDataReqBackoffTable[NWK_CONGESTION_TABLE_SIZE];
+#endif
+#ifdef NWK_ENABLE_AGGREGATION
+static NwkFrameQueue_t nwkDataReqAggregationQueue;
+static SYS_Timer_t nwkDataReqAggregationTimer;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -78,52 +104,101 @@ static NWK_DataReq_t *nwkDataReqQueue;
 void nwkDataReqInit(void)
 {
   nwkDataReqQueue = NULL;
+  nwkDataReqQueueTail = NULL;
+  nwkDataReqRound = 0;
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  for (uint8_t i = 0; i < NWK_CONGESTION_TABLE_SIZE; i++)
+    nwkDataReqBackoffTable[i].used = false;
+#endif
+
+#ifdef NWK_ENABLE_AGGREGATION
+  nwkFrameQueueInit(&nwkDataReqAggregationQueue);
+
+  nwkDataReqAggregationTimer.interval = NWK_AGGREGATION_TIMEOUT;
+  nwkDataReqAggregationTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkDataReqAggregationTimer.handler = nwkDataReqAggregationTimerHandler;
+#endif
 }
 
 /*************************************************************************//**
-  @brief Adds request @a req to the queue of outgoing requests
+  @brief Adds request @a req to the tail of the queue of outgoing requests
   @param[in] req Pointer to the request parameters
 *****************************************************************************/
-void NWK_DataReq(NWK_DataReq_t *req)
+static void nwkDataReqQueueAdd(NWK_DataReq_t *req)
 {
   req->state = NWK_DATA_REQ_STATE_INITIAL;
   req->status = NWK_SUCCESS_STATUS;
-  req->frame = NULL;
+  req->next = NULL;
 
   nwkIb.lock++;
 
   if (NULL == nwkDataReqQueue)
-  {
-    req->next = NULL;
     nwkDataReqQueue = req;
-  }
   else
-  {
-    req->next = nwkDataReqQueue;
-    nwkDataReqQueue = req;
-  }
+    nwkDataReqQueueTail->next = req;
+
+  nwkDataReqQueueTail = req;
 }
 
 /*************************************************************************//**
-  @brief Prepares and send outgoing frame based on the request @a req parameters
+  @brief Adds request @a req to the queue of outgoing requests
   @param[in] req Pointer to the request parameters
 *****************************************************************************/
-static void nwkDataReqSendFrame(NWK_DataReq_t *req)
+void NWK_DataReq(NWK_DataReq_t *req)
+{
+  req->frame = NULL;
+  nwkDataReqQueueAdd(req);
+}
+
+/*************************************************************************//**
+  @brief Allocates an outgoing frame for the request @a req, so that
+         the payload can be written directly into the frame buffer
+  @param[in] req Pointer to the request parameters, all parameters except
+             @a data and @a size must be set before the call
+  @return Pointer to the frame payload or NULL if there are no free buffers.
+          Up to NWK_MAX_PAYLOAD_SIZE bytes may be written, less the security
+          MIC and the multicast header when they are enabled. A non-NULL
+          result must be followed by NWK_DataReqCommit().
+*****************************************************************************/
+uint8_t *NWK_DataReqAlloc(NWK_DataReq_t *req)
 {
   NwkFrame_t *frame;
 
-  if (NULL == (frame = nwkFrameAlloc()))
-  {
-    req->state = NWK_DATA_REQ_STATE_CONFIRM;
-    req->status = NWK_OUT_OF_MEMORY_STATUS;
-    return;
-  }
+  if (NULL == (frame = nwkFrameAlloc(NWK_BUFFER_CLASS_DATA, NWK_FRAME_MAX_PAYLOAD_SIZE)))
+    return NULL;
 
+  nwkDataReqPrepareFrame(req, frame);
   req->frame = frame;
-  req->state = NWK_DATA_REQ_STATE_WAIT_CONF;
 
+  return frame->payload;
+}
+
+/*************************************************************************//**
+  @brief Adds request @a req with the payload already written into the frame
+         returned by NWK_DataReqAlloc() to the queue of outgoing requests
+  @param[in] req Pointer to the request parameters, @a size must be set to
+             the number of payload bytes written
+*****************************************************************************/
+void NWK_DataReqCommit(NWK_DataReq_t *req)
+{
+  NwkFrame_t *frame = (NwkFrame_t *)req->frame;
+
+  frame->size += req->size;
+  nwkDataReqQueueAdd(req);
+}
+
+/*************************************************************************//**
+  @brief Prepares outgoing frame @a frame based on the request @a req
+         parameters, the payload is not copied
+  @param[in] req Pointer to the request parameters
+  @param[in] frame Pointer to the frame
+*****************************************************************************/
+static void nwkDataReqPrepareFrame(NWK_DataReq_t *req, NwkFrame_t *frame)
+{
   frame->tx.confirm = nwkDataReqTxConf;
   frame->tx.control = req->options & NWK_OPT_BROADCAST_PAN_ID ? NWK_TX_CONTROL_BROADCAST_PAN_ID : 0;
+  frame->tx.priority = req->priority < NWK_PRIORITY_LEVELS ? req->priority : NWK_PRIORITY_DATA;
 
   frame->header.nwkFcf.ackRequest = req->options & NWK_OPT_ACK_REQUEST ? 1 : 0;
   frame->header.nwkFcf.linkLocal = req->options & NWK_OPT_LINK_LOCAL ? 1 : 0;
@@ -149,32 +224,307 @@ static void nwkDataReqSendFrame(NWK_DataReq_t *req)
   }
 #endif
 
-  frame->header.nwkSeq = ++nwkIb.nwkSeqNum;
   frame->header.nwkSrcAddr = nwkIb.addr;
   frame->header.nwkDstAddr = req->dstAddr;
   frame->header.nwkSrcEndpoint = req->srcEndpoint;
   frame->header.nwkDstEndpoint = req->dstEndpoint;
+}
 
-  memcpy(frame->payload, req->data, req->size);
-  frame->size += req->size;
+#ifdef NWK_ENABLE_AGGREGATION
+/*************************************************************************//**
+  @brief Checks if request @a req may share the aggregated @a frame
+  @param[in] req Pointer to the request parameters
+  @param[in] frame Pointer to the aggregated frame
+  @return @c true if the frame goes to the same destination with the same options
+*****************************************************************************/
+static bool nwkDataReqAggregationMatch(NWK_DataReq_t *req, NwkFrame_t *frame)
+{
+  NwkFrameHeader_t *header = &frame->header;
+
+  if (header->nwkDstAddr != req->dstAddr ||
+      header->nwkFcf.ackRequest != (req->options & NWK_OPT_ACK_REQUEST ? 1 : 0) ||
+      header->nwkFcf.linkLocal != (req->options & NWK_OPT_LINK_LOCAL ? 1 : 0) ||
+      (frame->tx.control & NWK_TX_CONTROL_BROADCAST_PAN_ID) != (req->options & NWK_OPT_BROADCAST_PAN_ID ?
+      NWK_TX_CONTROL_BROADCAST_PAN_ID : 0))
+    return false;
+
+#ifdef NWK_ENABLE_SECURITY
+  if (header->nwkFcf.security != (req->options & NWK_OPT_ENABLE_SECURITY ? 1 : 0))
+    return false;
+#endif
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Checks if @a size bytes of payload fit into the aggregated @a frame
+  @param[in] frame Pointer to the aggregated frame
+  @param[in] size Size of the message payload
+  @return @c true if the message and its sub-header fit
+*****************************************************************************/
+static bool nwkDataReqAggregationFits(NwkFrame_t *frame, uint8_t size)
+{
+  uint16_t total = frame->size + sizeof(NwkFrameAggregateHeader_t) + size;
+
+#ifdef NWK_ENABLE_SECURITY
+  if (frame->header.nwkFcf.security)
+    total += NWK_SECURITY_MIC_SIZE;
+#endif
+
+  return total <= NWK_DATA_REQ_AGGREGATION_MAX_SIZE;
+}
+
+/*************************************************************************//**
+  @brief Stops aggregation for the @a frame and sends it
+  @param[in] frame Pointer to the aggregated frame
+*****************************************************************************/
+static void nwkDataReqAggregationSend(NwkFrame_t *frame)
+{
+  NwkFrameAggregateHeader_t *sub = (NwkFrameAggregateHeader_t *)frame->payload;
+
+  nwkFrameQueueRemove(&nwkDataReqAggregationQueue, frame);
+
+  // A single message is sent as a regular frame, the header already has
+  // its endpoints
+  if (nwkFramePayloadSize(frame) == sizeof(NwkFrameAggregateHeader_t) + sub->size)
+  {
+    memmove(frame->payload, frame->payload + sizeof(NwkFrameAggregateHeader_t), sub->size);
+    frame->size -= sizeof(NwkFrameAggregateHeader_t);
+    frame->header.nwkFcf.aggregate = 0;
+  }
+
+  frame->header.nwkSeq = ++nwkIb.nwkSeqNum;
+
+  nwkTxFrame(frame);
+}
+
+/*************************************************************************//**
+  @brief Appends the request @a req to an aggregated frame for the same
+         destination, a new frame is started if there is none or it is full
+  @param[in] req Pointer to the request parameters
+  @return @c false if the request can not be aggregated and must be sent as
+          a regular frame
+*****************************************************************************/
+static bool nwkDataReqAggregate(NWK_DataReq_t *req)
+{
+  NwkFrame_t *frame;
+  NwkFrameAggregateHeader_t *sub;
+
+  for (frame = nwkDataReqAggregationQueue.head; frame; frame = frame->next)
+  {
+    if (nwkDataReqAggregationMatch(req, frame))
+      break;
+  }
+
+  if (frame && !nwkDataReqAggregationFits(frame, req->size))
+  {
+    nwkDataReqAggregationSend(frame);
+    frame = NULL;
+  }
+
+  if (NULL == frame)
+  {
+    if (NULL == (frame = nwkFrameAlloc(NWK_BUFFER_CLASS_DATA, NWK_FRAME_MAX_PAYLOAD_SIZE)))
+    {
+      req->state = NWK_DATA_REQ_STATE_CONFIRM;
+      req->status = NWK_OUT_OF_MEMORY_STATUS;
+      return true;
+    }
+
+    nwkDataReqPrepareFrame(req, frame);
+
+    if (!nwkDataReqAggregationFits(frame, req->size))
+    {
+      nwkFrameFree(frame);
+      return false;
+    }
+
+    frame->header.nwkFcf.aggregate = 1;
+    frame->tx.timeout = SYS_TimerGetTime() + NWK_AGGREGATION_TIMEOUT;
+    nwkFrameQueuePush(&nwkDataReqAggregationQueue, frame);
+
+    // A running timer is armed for an earlier deadline
+    if (!SYS_TimerStarted(&nwkDataReqAggregationTimer))
+    {
+      nwkDataReqAggregationTimer.interval = NWK_AGGREGATION_TIMEOUT;
+      SYS_TimerStart(&nwkDataReqAggregationTimer);
+    }
+  }
+
+  sub = (NwkFrameAggregateHeader_t *)(frame->data + frame->size);
+  sub->srcEndpoint = req->srcEndpoint;
+  sub->dstEndpoint = req->dstEndpoint;
+  sub->size = req->size;
+  memcpy((uint8_t *)sub + sizeof(NwkFrameAggregateHeader_t), req->data, req->size);
+  frame->size += sizeof(NwkFrameAggregateHeader_t) + req->size;
+
+  if (req->priority < NWK_PRIORITY_LEVELS && req->priority > frame->tx.priority)
+    frame->tx.priority = req->priority;
+
+  req->frame = frame;
+  req->state = NWK_DATA_REQ_STATE_WAIT_CONF;
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Sends aggregated frames to @a dstAddr right away, so that a regular
+         frame to the same destination does not overtake their messages
+  @param[in] dstAddr Destination address
+*****************************************************************************/
+static void nwkDataReqAggregationFlush(uint16_t dstAddr)
+{
+  NwkFrame_t *frame = nwkDataReqAggregationQueue.head;
+
+  while (frame)
+  {
+    NwkFrame_t *next = frame->next;
+
+    if (frame->header.nwkDstAddr == dstAddr)
+      nwkDataReqAggregationSend(frame);
+
+    frame = next;
+  }
+}
+
+/*************************************************************************//**
+  @brief Sends aggregated frames that have been held for NWK_AGGREGATION_TIMEOUT
+         and arms the @a timer for the next deadline. Frames are queued in
+         the order of their deadlines.
+  @param[in] timer Pointer to the timer
+*****************************************************************************/
+static void nwkDataReqAggregationTimerHandler(SYS_Timer_t *timer)
+{
+  NwkFrame_t *frame;
+
+  while (NULL != (frame = nwkDataReqAggregationQueue.head) &&
+      (int32_t)(frame->tx.timeout - SYS_TimerGetTime()) <= 0)
+    nwkDataReqAggregationSend(frame);
+
+  if (frame)
+  {
+    timer->interval = frame->tx.timeout - SYS_TimerGetTime();
+    SYS_TimerStart(timer);
+  }
+}
+#endif // NWK_ENABLE_AGGREGATION
+
+/*************************************************************************//**
+  @brief Prepares and send outgoing frame based on the request @a req parameters
+  @param[in] req Pointer to the request parameters
+*****************************************************************************/
+static void nwkDataReqSendFrame(NWK_DataReq_t *req)
+{
+  NwkFrame_t *frame = (NwkFrame_t *)req->frame;
+
+#ifdef NWK_ENABLE_AGGREGATION
+  if (NULL == frame && (req->options & NWK_OPT_AGGREGATE) &&
+      0 == (req->options & NWK_OPT_MULTICAST) && nwkDataReqAggregate(req))
+    return;
+
+  nwkDataReqAggregationFlush(req->dstAddr);
+#endif
+
+  if (NULL == frame)
+  {
+    if (NULL == (frame = nwkFrameAlloc(NWK_BUFFER_CLASS_DATA, NWK_FRAME_MAX_PAYLOAD_SIZE)))
+    {
+      req->state = NWK_DATA_REQ_STATE_CONFIRM;
+      req->status = NWK_OUT_OF_MEMORY_STATUS;
+      return;
+    }
+
+    nwkDataReqPrepareFrame(req, frame);
+    memcpy(frame->payload, req->data, req->size);
+    frame->size += req->size;
+
+    req->frame = frame;
+  }
+
+  req->state = NWK_DATA_REQ_STATE_WAIT_CONF;
+
+  frame->header.nwkSeq = ++nwkIb.nwkSeqNum;
 
   nwkTxFrame(frame);
 }
 
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+/*************************************************************************//**
+  @brief Checks if the backoff @a entry is still in effect
+*****************************************************************************/
+static bool nwkDataReqBackoffAlive(NwkDataReqBackoffEntry_t *entry)
+{
+  return entry->used && (SYS_TimerGetTime() - entry->time) < NWK_CONGESTION_BACKOFF_TIME;
+}
+
+/*************************************************************************//**
+  @brief Holds new requests to @a dstAddr for NWK_CONGESTION_BACKOFF_TIME,
+         the oldest entry is replaced when the table is full
+*****************************************************************************/
+static void nwkDataReqBackoffStart(uint16_t dstAddr)
+{
+  NwkDataReqBackoffEntry_t *entry = &nwkDataReqBackoffTable[0];
+
+  for (uint8_t i = 0; i < NWK_CONGESTION_TABLE_SIZE; i++)
+  {
+    NwkDataReqBackoffEntry_t *e = &nwkDataReqBackoffTable[i];
+
+    if (e->used && e->dstAddr == dstAddr)
+    {
+      entry = e;
+      break;
+    }
+
+    if (!nwkDataReqBackoffAlive(e))
+      entry = e;
+    else if (nwkDataReqBackoffAlive(entry) && (int32_t)(e->time - entry->time) < 0)
+      entry = e;
+  }
+
+  entry->dstAddr = dstAddr;
+  entry->used = true;
+  entry->time = SYS_TimerGetTime();
+  nwkIb.stats.congestionBackoffs++;
+}
+
+/*************************************************************************//**
+  @brief Checks if the destination of the request @a req reported congestion
+         less than NWK_CONGESTION_BACKOFF_TIME ago
+*****************************************************************************/
+static bool nwkDataReqBackedOff(NWK_DataReq_t *req)
+{
+  for (uint8_t i = 0; i < NWK_CONGESTION_TABLE_SIZE; i++)
+  {
+    NwkDataReqBackoffEntry_t *entry = &nwkDataReqBackoffTable[i];
+
+    if (entry->dstAddr == req->dstAddr && nwkDataReqBackoffAlive(entry))
+      return true;
+  }
+
+  return false;
+}
+#endif
+
 /*************************************************************************//**
   @brief Frame transmission confirmation handler
   @param[in] frame Pointer to the sent frame
 *****************************************************************************/
 static void nwkDataReqTxConf(NwkFrame_t *frame)
 {
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  if (NWK_SUCCESS_STATUS == frame->tx.status && (frame->tx.control & NWK_ACK_CONTROL_CONGESTED))
+    nwkDataReqBackoffStart(frame->header.nwkDstAddr);
+#endif
+
   for (NWK_DataReq_t *req = nwkDataReqQueue; req; req = req->next)
   {
-    if (req->frame == frame)
+    // Aggregated frames carry several requests, all of them are confirmed
+    if (req->frame == frame && NWK_DATA_REQ_STATE_WAIT_CONF == req->state)
     {
       req->status = frame->tx.status;
       req->control = frame->tx.control;
+      req->attempts = frame->header.nwkFcf.attempt + 1;
       req->state = NWK_DATA_REQ_STATE_CONFIRM;
-      break;
     }
   }
 
@@ -187,48 +537,125 @@ static void nwkDataReqTxConf(NwkFrame_t *frame)
 *****************************************************************************/
 static void nwkDataReqConfirm(NWK_DataReq_t *req)
 {
+  NWK_DataReq_t *prev = NULL;
+
   if (nwkDataReqQueue == req)
   {
     nwkDataReqQueue = nwkDataReqQueue->next;
   }
   else
   {
-    NWK_DataReq_t *prev = nwkDataReqQueue;
+    prev = nwkDataReqQueue;
     while (prev->next != req)
       prev = prev->next;
     prev->next = ((NWK_DataReq_t *)prev->next)->next;
   }
 
+  if (nwkDataReqQueueTail == req)
+    nwkDataReqQueueTail = prev;
+
   nwkIb.lock--;
   req->confirm(req);
 }
 
+#if defined(NWK_ENABLE_BLOCK_ACK) || NWK_ACK_RETRIES > 0
 /*************************************************************************//**
-  @brief Data Request module task handler
+  @brief Checks if NWK_ACK_WINDOW acknowledged frames to the destination of
+         the request @a req are already waiting for confirmation
 *****************************************************************************/
-void nwkDataReqTaskHandler(void)
+static bool nwkDataReqWindowFull(NWK_DataReq_t *req)
+{
+  uint8_t inFlight = 0;
+
+  if (0 == (req->options & NWK_OPT_ACK_REQUEST))
+    return false;
+
+  for (NWK_DataReq_t *r = nwkDataReqQueue; r; r = r->next)
+  {
+    if (NWK_DATA_REQ_STATE_WAIT_CONF == r->state && r->dstAddr == req->dstAddr &&
+        (r->options & NWK_OPT_ACK_REQUEST))
+      inFlight++;
+  }
+
+  return inFlight >= NWK_ACK_WINDOW;
+}
+#endif
+
+/*************************************************************************//**
+  @brief Checks if the request @a req has to wait for an older request to the
+         same destination, or if that destination was already served in the
+         current round
+*****************************************************************************/
+static bool nwkDataReqBlocked(NWK_DataReq_t *req)
 {
+  for (NWK_DataReq_t *r = nwkDataReqQueue; r != req; r = r->next)
+  {
+    if (r->dstAddr == req->dstAddr &&
+        (NWK_DATA_REQ_STATE_INITIAL == r->state || nwkDataReqRound == r->round))
+      return true;
+  }
+
+  return false;
+}
+
+/*************************************************************************//**
+  @brief Sends the oldest pending request to every destination
+  @return @c true if at least one request was sent
+*****************************************************************************/
+static bool nwkDataReqDispatchRound(void)
+{
+  bool sent = false;
+
+  nwkDataReqRound++;
+
   for (NWK_DataReq_t *req = nwkDataReqQueue; req; req = req->next)
   {
-    switch (req->state)
-    {
-      case NWK_DATA_REQ_STATE_INITIAL:
-      {
-        nwkDataReqSendFrame(req);
-        return;
-      } break;
+    if (NWK_DATA_REQ_STATE_INITIAL != req->state || nwkDataReqBlocked(req))
+      continue;
+
+  #if defined(NWK_ENABLE_BLOCK_ACK) || NWK_ACK_RETRIES > 0
+    if (nwkDataReqWindowFull(req))
+      continue;
+  #endif
 
-      case NWK_DATA_REQ_STATE_WAIT_CONF:
-        break;
+  #ifdef NWK_ENABLE_CONGESTION_CONTROL
+    if (nwkDataReqBackedOff(req))
+      continue;
+  #endif
 
-      case NWK_DATA_REQ_STATE_CONFIRM:
-      {
-        nwkDataReqConfirm(req);
-        return;
-      } break;
+    // Requests without a buffer wait for one instead of failing
+    if (NULL == req->frame && !nwkFrameAvailable(NWK_BUFFER_CLASS_DATA, NWK_FRAME_MAX_PAYLOAD_SIZE))
+      continue;
 
-      default:
-        break;
-    };
+    nwkDataReqSendFrame(req);
+    req->round = nwkDataReqRound;
+    sent = true;
   }
+
+  return sent;
+}
+
+/*************************************************************************//**
+  @brief Data Request module task handler
+
+  Finished requests are confirmed in the order they were made. Pending
+  requests are then sent in rounds, one request per destination in each
+  round, until the buffers run out.
+*****************************************************************************/
+void nwkDataReqTaskHandler(void)
+{
+  NWK_DataReq_t *req = nwkDataReqQueue;
+
+  while (req)
+  {
+    NWK_DataReq_t *next = req->next;
+
+    if (NWK_DATA_REQ_STATE_CONFIRM == req->state)
+      nwkDataReqConfirm(req);
+
+    req = next;
+  }
+
+  while (nwkDataReqDispatchRound())
+    ;
 }
@@ -63,6 +63,16 @@
 /*- Definitions ------------------------------------------------------------*/
 #define NWK_ROUTE_MAX_RANK         255
 #define NWK_ROUTE_DEFAULT_RANK     128
+#define NWK_ROUTE_INDEX_SIZE       (NWK_ROUTE_TABLE_SIZE + NWK_ROUTE_TABLE_SIZE / 2 + 1)
+#define NWK_ROUTE_INDEX_EMPTY      0
+
+/*- Types ------------------------------------------------------------------*/
+// Index slots hold the table position + 1, NWK_ROUTE_INDEX_EMPTY otherwise
+#if NWK_ROUTE_TABLE_SIZE < 255
+typedef uint8_t NwkRouteIndexSlot_t;
+#else
+typedef uint16_t NwkRouteIndexSlot_t;
+#endif
 
 /*- Prototypes -------------------------------------------------------------*/
 static void nwkRouteSendRouteError(uint16_t src, uint16_t dst, uint8_t multicast);
@@ -70,6 +80,9 @@ static void nwkRouteNormalizeRanks(void);
 
 /*- Variables --------------------------------------------------------------*/
 static NWK_RouteTableEntry_t nwkRouteTable[NWK_ROUTE_TABLE_SIZE];
+static NwkRouteIndexSlot_t nwkRouteIndex[NWK_ROUTE_INDEX_SIZE];
+static uint16_t nwkRouteIndexUsed;
+static bool nwkRouteIndexValid;
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -78,23 +91,94 @@ static NWK_RouteTableEntry_t nwkRouteTable[NWK_ROUTE_TABLE_SIZE];
 *****************************************************************************/
 void nwkRouteInit(void)
 {
-  for (uint8_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
+  for (uint16_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
   {
     nwkRouteTable[i].dstAddr = NWK_ROUTE_UNKNOWN;
     nwkRouteTable[i].fixed = 0;
     nwkRouteTable[i].rank = 0;
   }
+
+  nwkRouteIndexValid = false;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static inline uint16_t nwkRouteIndexHash(uint16_t dst, uint8_t multicast)
+{
+  return (dst ^ (dst >> 8) ^ (multicast ? 0x5a00 : 0)) % NWK_ROUTE_INDEX_SIZE;
+}
+
+/*************************************************************************//**
+  @brief Adds the @a entry to the index under its current address. Slots of
+         entries that were freed or reused are not removed, lookups skip them
+         and the index is rebuilt once it runs out of empty slots.
+*****************************************************************************/
+static void nwkRouteIndexAdd(NWK_RouteTableEntry_t *entry)
+{
+  uint16_t i;
+
+  if (!nwkRouteIndexValid)
+    return;
+
+  // At least one empty slot terminates every lookup
+  if (nwkRouteIndexUsed >= NWK_ROUTE_INDEX_SIZE - 1)
+  {
+    nwkRouteIndexValid = false;
+    return;
+  }
+
+  i = nwkRouteIndexHash(entry->dstAddr, entry->multicast);
+
+  while (NWK_ROUTE_INDEX_EMPTY != nwkRouteIndex[i])
+  {
+    if (++i == NWK_ROUTE_INDEX_SIZE)
+      i = 0;
+  }
+
+  nwkRouteIndex[i] = (entry - nwkRouteTable) + 1;
+  nwkRouteIndexUsed++;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkRouteIndexRebuild(void)
+{
+  for (uint16_t i = 0; i < NWK_ROUTE_INDEX_SIZE; i++)
+    nwkRouteIndex[i] = NWK_ROUTE_INDEX_EMPTY;
+
+  nwkRouteIndexUsed = 0;
+  nwkRouteIndexValid = true;
+
+  for (uint16_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
+  {
+    if (NWK_ROUTE_UNKNOWN != nwkRouteTable[i].dstAddr)
+      nwkRouteIndexAdd(&nwkRouteTable[i]);
+  }
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 NWK_RouteTableEntry_t *NWK_RouteFindEntry(uint16_t dst, uint8_t multicast)
 {
-  for (uint8_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
+  uint16_t i;
+
+  if (NWK_ROUTE_UNKNOWN == dst)
+    return NULL;
+
+  if (!nwkRouteIndexValid)
+    nwkRouteIndexRebuild();
+
+  i = nwkRouteIndexHash(dst, multicast);
+
+  while (NWK_ROUTE_INDEX_EMPTY != nwkRouteIndex[i])
   {
-    if (nwkRouteTable[i].dstAddr == dst &&
-        nwkRouteTable[i].multicast == multicast)
-      return &nwkRouteTable[i];
+    NWK_RouteTableEntry_t *entry = &nwkRouteTable[nwkRouteIndex[i] - 1];
+
+    if (entry->dstAddr == dst && entry->multicast == multicast)
+      return entry;
+
+    if (++i == NWK_ROUTE_INDEX_SIZE)
+      i = 0;
   }
 
   return NULL;
@@ -102,12 +186,12 @@ NWK_RouteTableEntry_t *NWK_RouteFindEntry(uint16_t dst, uint8_t multicast)
 
 /*************************************************************************//**
 *****************************************************************************/
-NWK_RouteTableEntry_t *NWK_RouteNewEntry(void)
+static NWK_RouteTableEntry_t *nwkRouteNewEntry(void)
 {
   NWK_RouteTableEntry_t *iter = nwkRouteTable;
   NWK_RouteTableEntry_t *entry = NULL;
 
-  for (uint8_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++, iter++)
+  for (uint16_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++, iter++)
   {
     if (iter->fixed)
       continue;
@@ -125,10 +209,24 @@ NWK_RouteTableEntry_t *NWK_RouteNewEntry(void)
   entry->multicast = 0;
   entry->score = NWK_ROUTE_DEFAULT_SCORE;
   entry->rank = NWK_ROUTE_DEFAULT_RANK;
+#ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+  entry->srtt = 0;
+  entry->rttvar = 0;
+#endif
 
   return entry;
 }
 
+/*************************************************************************//**
+  @brief Returns an entry for a new route, the caller sets its address.
+         The index is rebuilt on the next lookup.
+*****************************************************************************/
+NWK_RouteTableEntry_t *NWK_RouteNewEntry(void)
+{
+  nwkRouteIndexValid = false;
+  return nwkRouteNewEntry();
+}
+
 /*************************************************************************//**
 *****************************************************************************/
 void NWK_RouteFreeEntry(NWK_RouteTableEntry_t *entry)
@@ -153,9 +251,13 @@ uint16_t NWK_RouteNextHop(uint16_t dst, uint8_t multicast)
 }
 
 /*************************************************************************//**
+  @brief Returns the route table for direct access. Addresses may be changed
+         through the returned pointer until the next call to the NWK layer,
+         the index is rebuilt on the next lookup.
 *****************************************************************************/
 NWK_RouteTableEntry_t *NWK_RouteTable(void)
 {
+  nwkRouteIndexValid = false;
   return nwkRouteTable;
 }
 
@@ -168,16 +270,101 @@ void nwkRouteUpdateEntry(uint16_t dst, uint8_t multicast, uint16_t nextHop, uint
   entry = NWK_RouteFindEntry(dst, multicast);
 
   if (NULL == entry)
-    entry = NWK_RouteNewEntry();
+  {
+    entry = nwkRouteNewEntry();
+    entry->dstAddr = dst;
+    entry->multicast = multicast;
+    nwkRouteIndexAdd(entry);
+  }
 
-  entry->dstAddr = dst;
   entry->nextHopAddr = nextHop;
-  entry->multicast = multicast;
   entry->score = NWK_ROUTE_DEFAULT_SCORE;
   entry->rank = NWK_ROUTE_DEFAULT_RANK;
   entry->lqi = lqi;
 }
 
+#ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+/*************************************************************************//**
+  @brief Returns the ACK wait time for the destination @a dst derived from
+         the measured round-trip time as SRTT + 4 * RTTVAR, NWK_ACK_WAIT_TIME
+         is used until the first measurement is available
+*****************************************************************************/
+uint16_t nwkRouteAckWaitTime(uint16_t dst, uint8_t multicast)
+{
+  NWK_RouteTableEntry_t *entry;
+  uint32_t time;
+
+  entry = NWK_RouteFindEntry(dst, multicast);
+
+  if (NULL == entry || 0 == entry->srtt)
+    return NWK_ACK_WAIT_TIME;
+
+  time = (entry->srtt >> 3) + (uint32_t)entry->rttvar;
+
+  if (time < NWK_ACK_WAIT_TIME_MIN)
+    return NWK_ACK_WAIT_TIME_MIN;
+
+  if (time > NWK_ACK_WAIT_TIME_MAX)
+    return NWK_ACK_WAIT_TIME_MAX;
+
+  return time;
+}
+
+/*************************************************************************//**
+  @brief Updates the round-trip time estimation for the destination @a dst
+         with a new sample @a rtt (ms), the same way as TCP does (RFC 6298)
+*****************************************************************************/
+void nwkRouteAckReceived(uint16_t dst, uint8_t multicast, uint16_t rtt)
+{
+  NWK_RouteTableEntry_t *entry;
+  int16_t delta;
+
+  entry = NWK_RouteFindEntry(dst, multicast);
+
+  if (NULL == entry)
+    return;
+
+  if (rtt > NWK_ACK_WAIT_TIME_MAX)
+    rtt = NWK_ACK_WAIT_TIME_MAX;
+
+  if (0 == rtt)
+    rtt = 1;
+
+  if (0 == entry->srtt)
+  {
+    entry->srtt = rtt << 3;
+    entry->rttvar = rtt << 1;
+  }
+  else
+  {
+    delta = rtt - (entry->srtt >> 3);
+    entry->srtt += delta;
+
+    if (delta < 0)
+      delta = -delta;
+
+    entry->rttvar += delta - (entry->rttvar >> 2);
+  }
+}
+
+/*************************************************************************//**
+  @brief Backs off the ACK wait time for the destination @a dst after
+         a timeout, the variance is doubled until the next valid sample
+*****************************************************************************/
+void nwkRouteAckTimeout(uint16_t dst, uint8_t multicast)
+{
+  NWK_RouteTableEntry_t *entry;
+
+  entry = NWK_RouteFindEntry(dst, multicast);
+
+  if (NULL == entry || 0 == entry->srtt)
+    return;
+
+  if (entry->rttvar < NWK_ACK_WAIT_TIME_MAX)
+    entry->rttvar = (entry->rttvar << 1) | 1;
+}
+#endif
+
 /*************************************************************************//**
 *****************************************************************************/
 void nwkRouteRemove(uint16_t dst, uint8_t multicast)
@@ -219,10 +406,11 @@ void nwkRouteFrameReceived(NwkFrame_t *frame)
   }
   else
   {
-    entry = NWK_RouteNewEntry();
+    entry = nwkRouteNewEntry();
 
     entry->dstAddr = header->nwkSrcAddr;
     entry->nextHopAddr = header->macSrcAddr;
+    nwkRouteIndexAdd(entry);
   }
 
   entry->lqi = frame->rx.lqi;
@@ -304,6 +492,7 @@ void nwkRouteFrame(NwkFrame_t *frame)
   {
     frame->tx.confirm = NULL;
     frame->tx.control = NWK_TX_CONTROL_ROUTING;
+    frame->tx.priority = NWK_PRIORITY_ROUTED;
     nwkTxFrame(frame);
   }
   else
@@ -320,7 +509,7 @@ static void nwkRouteSendRouteError(uint16_t src, uint16_t dst, uint8_t multicast
   NwkFrame_t *frame;
   NwkCommandRouteError_t *command;
 
-  if (NULL == (frame = nwkFrameAlloc()))
+  if (NULL == (frame = nwkFrameAlloc(NWK_BUFFER_CLASS_CONTROL, NWK_FRAME_COMMAND_SIZE(NwkCommandRouteError_t))))
     return;
 
   nwkFrameCommandInit(frame);
@@ -357,7 +546,7 @@ bool nwkRouteErrorReceived(NWK_DataInd_t *ind)
 *****************************************************************************/
 static void nwkRouteNormalizeRanks(void)
 {
-  for (uint8_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
+  for (uint16_t i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
     nwkRouteTable[i].rank = (nwkRouteTable[i].rank >> 1) + 1;
 }
 
@@ -62,10 +62,18 @@
 #include "nwkRouteDiscovery.h"
 
 /*- Definitions ------------------------------------------------------------*/
-#define NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL   100 // ms
-#define DUPLICATE_REJECTION_TTL \
-            ((NWK_DUPLICATE_REJECTION_TTL / NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL) + 1)
+#define NWK_RX_DUPLICATE_REJECTION_PROBES          8
+#define NWK_RX_RETRY_TIME \
+            ((NWK_ACK_RETRIES + 1) * (NWK_ACK_WAIT_TIME + 2 * (NWK_ACK_RETRY_BACKOFF << NWK_ACK_RETRIES)))
+#if NWK_ACK_RETRIES > 0 && NWK_DUPLICATE_REJECTION_TTL < NWK_RX_RETRY_TIME
+  // Retransmissions must still be recognized as duplicates of the original frame
+  #define NWK_RX_DUPLICATE_REJECTION_TIME     NWK_RX_RETRY_TIME
+#else
+  #define NWK_RX_DUPLICATE_REJECTION_TIME     NWK_DUPLICATE_REJECTION_TTL
+#endif
 #define NWK_SERVICE_ENDPOINT_ID    0
+#define NWK_RX_AGGREGATE_MASK_SIZE \
+            ((NWK_FRAME_MAX_PAYLOAD_SIZE / sizeof(NwkFrameAggregateHeader_t) + 7) / 8)
 
 /*- Types ------------------------------------------------------------------*/
 enum
@@ -75,24 +83,77 @@ enum
   NWK_RX_STATE_INDICATE = 0x22,
   NWK_RX_STATE_ROUTE    = 0x23,
   NWK_RX_STATE_FINISH   = 0x24,
+  NWK_RX_STATE_DEFERRED = 0x25,
 };
 
+#if NWK_DUPLICATE_REJECTION_WINDOW == 64
+typedef uint64_t NwkRxWindow_t;
+#elif NWK_DUPLICATE_REJECTION_WINDOW == 32
+typedef uint32_t NwkRxWindow_t;
+#elif NWK_DUPLICATE_REJECTION_WINDOW == 16
+typedef uint16_t NwkRxWindow_t;
+#else
+typedef uint8_t NwkRxWindow_t;
+#endif
+
 typedef struct NwkDuplicateRejectionEntry_t
 {
-  uint16_t src;
+  uint16_t      src;
+  uint8_t       seq;
+  NwkRxWindow_t mask;
+  NwkRxWindow_t acked;
+  NwkRxWindow_t attemptLo; // the last accepted attempt, bit 0
+  NwkRxWindow_t attemptHi; // the last accepted attempt, bit 1
+  bool          used;
+  uint32_t      time;      // when the window was last moved
+} NwkDuplicateRejectionEntry_t;
+
+#ifdef NWK_ENABLE_BLOCK_ACK
+typedef struct NwkRxPendingAck_t
+{
+  bool     active;
+  uint16_t dst;
   uint8_t  seq;
   uint8_t  mask;
-  uint8_t  ttl;
-} NwkDuplicateRejectionEntry_t;
+  uint8_t  control;
+  uint8_t  security;
+} NwkRxPendingAck_t;
+#endif
+
+#ifdef NWK_ENABLE_AGGREGATION
+typedef struct NwkRxAggregateEntry_t
+{
+  bool     used;
+  uint16_t src;
+  uint8_t  seq;
+  uint32_t time;
+  uint8_t  delivered[NWK_RX_AGGREGATE_MASK_SIZE]; // accepted messages
+} NwkRxAggregateEntry_t;
+#endif
 
 /*- Prototypes -------------------------------------------------------------*/
-static void nwkRxDuplicateRejectionTimerHandler(SYS_Timer_t *timer);
 static bool nwkRxServiceDataInd(NWK_DataInd_t *ind);
+#ifdef NWK_ENABLE_BLOCK_ACK
+static void nwkRxAckDelayTimerHandler(SYS_Timer_t *timer);
+#endif
 
 /*- Variables --------------------------------------------------------------*/
 static NwkDuplicateRejectionEntry_t nwkRxDuplicateRejectionTable[NWK_DUPLICATE_REJECTION_TABLE_SIZE];
 static uint8_t nwkRxAckControl;
-static SYS_Timer_t nwkRxDuplicateRejectionTimer;
+static NwkFrameQueue_t nwkRxQueue;
+static NwkFrame_t *nwkRxIndFrame;
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+static bool nwkRxCongested;
+static bool nwkRxOverflow;
+static void (*nwkRxCongestionHandler)(bool congested);
+#endif
+#ifdef NWK_ENABLE_BLOCK_ACK
+static NwkRxPendingAck_t nwkRxPendingAck[NWK_BLOCK_ACK_TABLE_SIZE];
+static SYS_Timer_t nwkRxAckDelayTimer;
+#endif
+#ifdef NWK_ENABLE_AGGREGATION
+static NwkRxAggregateEntry_t nwkRxAggregateTable[NWK_AGGREGATION_RX_TABLE_SIZE];
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -101,62 +162,354 @@ static SYS_Timer_t nwkRxDuplicateRejectionTimer;
 *****************************************************************************/
 void nwkRxInit(void)
 {
-  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
-    nwkRxDuplicateRejectionTable[i].ttl = 0;
+  for (uint16_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
+    nwkRxDuplicateRejectionTable[i].used = false;
 
-  nwkRxDuplicateRejectionTimer.interval = NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL;
-  nwkRxDuplicateRejectionTimer.mode = SYS_TIMER_INTERVAL_MODE;
-  nwkRxDuplicateRejectionTimer.handler = nwkRxDuplicateRejectionTimerHandler;
+#ifdef NWK_ENABLE_BLOCK_ACK
+  for (uint8_t i = 0; i < NWK_BLOCK_ACK_TABLE_SIZE; i++)
+    nwkRxPendingAck[i].active = false;
+
+  nwkRxAckDelayTimer.interval = NWK_BLOCK_ACK_DELAY;
+  nwkRxAckDelayTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkRxAckDelayTimer.handler = nwkRxAckDelayTimerHandler;
+#endif
+
+#ifdef NWK_ENABLE_AGGREGATION
+  for (uint8_t i = 0; i < NWK_AGGREGATION_RX_TABLE_SIZE; i++)
+    nwkRxAggregateTable[i].used = false;
+#endif
+
+  nwkFrameQueueInit(&nwkRxQueue);
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  nwkRxCongested = false;
+  nwkRxOverflow = false;
+  nwkRxCongestionHandler = NULL;
+#endif
 
   NWK_OpenEndpoint(NWK_SERVICE_ENDPOINT_ID, nwkRxServiceDataInd);
 }
 
 /*************************************************************************//**
+  @brief Checks the raw header of the received frame before a buffer is
+         allocated for it
+  @param[in] ind Pointer to the PHY indication parameters
+  @return One of the NWK_RX_DROP_* reasons or NWK_RX_DROP_REASONS_AMOUNT if
+          the frame must be processed
+*****************************************************************************/
+static uint8_t nwkRxFilterFrame(PHY_DataInd_t *ind)
+{
+  NwkFrameHeader_t *header = (NwkFrameHeader_t *)ind->data;
+
+  if (0x88 != ind->data[1] || (0x61 != ind->data[0] && 0x41 != ind->data[0]) ||
+      ind->size < sizeof(NwkFrameHeader_t) || ind->size > NWK_FRAME_MAX_PAYLOAD_SIZE)
+    return NWK_RX_DROP_INVALID;
+
+  if (nwkIb.panId != header->macDstPanId && NWK_BROADCAST_PANID != header->macDstPanId)
+    return NWK_RX_DROP_FOREIGN_PAN;
+
+  if (nwkIb.addr == header->macSrcAddr || nwkIb.addr == header->nwkSrcAddr)
+    return NWK_RX_DROP_OWN_FRAME;
+
+  // Frames are only routed if this node is the next hop
+  if (nwkIb.addr != header->macDstAddr && NWK_BROADCAST_ADDR != header->macDstAddr)
+    return NWK_RX_DROP_NOT_FOR_US;
+
+  return NWK_RX_DROP_REASONS_AMOUNT;
+}
+
+/*************************************************************************//**
+  @brief Accepts a received frame, @a ind data points into the transceiver
+         buffer, so the frame is copied only once it passes the header check
 *****************************************************************************/
 void PHY_DataInd(PHY_DataInd_t *ind)
 {
   NwkFrame_t *frame;
+  uint8_t reason = nwkRxFilterFrame(ind);
 
-  if (0x88 != ind->data[1] || (0x61 != ind->data[0] && 0x41 != ind->data[0]) ||
-      ind->size < sizeof(NwkFrameHeader_t))
+  if (reason < NWK_RX_DROP_REASONS_AMOUNT)
+  {
+    nwkIb.stats.rxDropped[reason]++;
     return;
+  }
 
-  if (NULL == (frame = nwkFrameAlloc()))
+  if (NULL == (frame = nwkFrameAlloc(NWK_BUFFER_CLASS_RX, ind->size)))
+  {
+    nwkIb.stats.rxDropped[NWK_RX_DROP_NO_BUFFER]++;
+  #ifdef NWK_ENABLE_CONGESTION_CONTROL
+    nwkRxOverflow = true;
+  #endif
     return;
+  }
 
   frame->state = NWK_RX_STATE_RECEIVED;
   frame->size = ind->size;
   frame->rx.lqi = ind->lqi;
   frame->rx.rssi = ind->rssi;
   memcpy(frame->data, ind->data, ind->size);
+
+  nwkFrameQueuePush(&nwkRxQueue, frame);
 }
 
 /*************************************************************************//**
+  @brief Sends an acknowledgement for the frame @a seq from the node @a dst,
+         a non-zero @a mask acknowledges the preceding frames as well and
+         a block acknowledgement is sent instead
 *****************************************************************************/
-static void nwkRxSendAck(NwkFrame_t *frame)
+static void nwkRxSendAckCommand(uint16_t dst, uint8_t security, uint8_t seq,
+    uint8_t mask, uint8_t control)
 {
   NwkFrame_t *ack;
-  NwkCommandAck_t *command;
 
-  if (NULL == (ack = nwkFrameAlloc()))
-    return;
+#ifdef NWK_ENABLE_BLOCK_ACK
+  if (mask)
+  {
+    NwkCommandBlockAck_t *command;
 
-  nwkFrameCommandInit(ack);
+    if (NULL == (ack = nwkFrameAlloc(NWK_BUFFER_CLASS_CONTROL, NWK_FRAME_COMMAND_SIZE(NwkCommandBlockAck_t))))
+      return;
 
-  ack->size += sizeof(NwkCommandAck_t);
-  ack->tx.confirm = NULL;
+    nwkFrameCommandInit(ack);
+    ack->size += sizeof(NwkCommandBlockAck_t);
+
+    command = (NwkCommandBlockAck_t *)ack->payload;
+    command->id = NWK_COMMAND_BLOCK_ACK;
+    command->seq = seq;
+    command->mask = mask;
+    command->control = control;
+  }
+  else
+#endif
+  {
+    NwkCommandAck_t *command;
+
+    if (NULL == (ack = nwkFrameAlloc(NWK_BUFFER_CLASS_CONTROL, NWK_FRAME_COMMAND_SIZE(NwkCommandAck_t))))
+      return;
 
-  ack->header.nwkFcf.security = frame->header.nwkFcf.security;
-  ack->header.nwkDstAddr = frame->header.nwkSrcAddr;
+    nwkFrameCommandInit(ack);
+    ack->size += sizeof(NwkCommandAck_t);
 
-  command = (NwkCommandAck_t *)ack->payload;
-  command->id = NWK_COMMAND_ACK;
-  command->control = nwkRxAckControl;
-  command->seq = frame->header.nwkSeq;
+    command = (NwkCommandAck_t *)ack->payload;
+    command->id = NWK_COMMAND_ACK;
+    command->seq = seq;
+    command->control = control;
+  }
+
+  ack->tx.confirm = NULL;
+  ack->tx.priority = NWK_PRIORITY_ACK;
+
+  ack->header.nwkFcf.security = security;
+  ack->header.nwkDstAddr = dst;
 
   nwkTxFrame(ack);
 }
 
+#ifdef NWK_ENABLE_BLOCK_ACK
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkRxFlushAck(NwkRxPendingAck_t *entry)
+{
+  nwkRxSendAckCommand(entry->dst, entry->security, entry->seq, entry->mask, entry->control);
+  entry->active = false;
+}
+
+/*************************************************************************//**
+  @brief Adds the acknowledgement for the frame @a frame to a pending block
+         acknowledgement for the same originator, the pending
+         acknowledgements are sent NWK_BLOCK_ACK_DELAY after the first one
+  @return @c false if there is no free entry and the frame must be
+          acknowledged immediately
+*****************************************************************************/
+static bool nwkRxCoalesceAck(NwkFrame_t *frame)
+{
+  NwkFrameHeader_t *header = &frame->header;
+  NwkRxPendingAck_t *freeEntry = NULL;
+
+  for (uint8_t i = 0; i < NWK_BLOCK_ACK_TABLE_SIZE; i++)
+  {
+    NwkRxPendingAck_t *entry = &nwkRxPendingAck[i];
+
+    if (!entry->active)
+    {
+      freeEntry = entry;
+      continue;
+    }
+
+    if (entry->dst != header->nwkSrcAddr || entry->security != header->nwkFcf.security)
+      continue;
+
+    if (entry->control == nwkRxAckControl)
+    {
+      int8_t diff = (int8_t)(entry->seq - header->nwkSeq);
+
+      if (0 == diff)
+        return true;
+
+      if (diff > 0 && diff <= 8)
+      {
+        entry->mask |= (1 << (diff - 1));
+        return true;
+      }
+
+      if (diff < 0 && diff >= -8)
+      {
+        uint16_t bits = (((uint16_t)entry->mask << 1) | 1) << -diff;
+
+        // Older frames must not fall out of the bitmap
+        if (bits < 0x200)
+        {
+          entry->seq = header->nwkSeq;
+          entry->mask = bits >> 1;
+          return true;
+        }
+      }
+    }
+
+    nwkRxFlushAck(entry);
+    freeEntry = entry;
+    break;
+  }
+
+  if (NULL == freeEntry)
+    return false;
+
+  freeEntry->active = true;
+  freeEntry->dst = header->nwkSrcAddr;
+  freeEntry->seq = header->nwkSeq;
+  freeEntry->mask = 0;
+  freeEntry->control = nwkRxAckControl;
+  freeEntry->security = header->nwkFcf.security;
+
+  SYS_TimerStart(&nwkRxAckDelayTimer);
+
+  return true;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkRxAckDelayTimerHandler(SYS_Timer_t *timer)
+{
+  for (uint8_t i = 0; i < NWK_BLOCK_ACK_TABLE_SIZE; i++)
+  {
+    if (nwkRxPendingAck[i].active)
+      nwkRxFlushAck(&nwkRxPendingAck[i]);
+  }
+
+  (void)timer;
+}
+#endif
+
+/*************************************************************************//**
+  @brief Checks if the duplicate rejection @a entry is still valid
+*****************************************************************************/
+static bool nwkRxDuplicateEntryAlive(NwkDuplicateRejectionEntry_t *entry)
+{
+  return entry->used && (SYS_TimerGetTime() - entry->time) <= NWK_RX_DUPLICATE_REJECTION_TIME;
+}
+
+/*************************************************************************//**
+  @brief Finds the duplicate rejection entry for the source address @a src
+  @param[in] src Network source address
+  @param[in] create Take over a free, expired or least recently used entry
+             if there is no entry for the @a src
+  @return Pointer to the entry or NULL if it was not found. A taken over
+          entry is returned with the @a used field cleared.
+
+  Entries are kept in an open addressed hash table, an entry for the @a src
+  may only be in NWK_RX_DUPLICATE_REJECTION_PROBES slots following its hash.
+*****************************************************************************/
+static NwkDuplicateRejectionEntry_t *nwkRxDuplicateEntryFind(uint16_t src, bool create)
+{
+  NwkDuplicateRejectionEntry_t *victim = NULL;
+  uint16_t index = (src ^ (src >> 8)) % NWK_DUPLICATE_REJECTION_TABLE_SIZE;
+
+  for (uint16_t i = 0; i < NWK_RX_DUPLICATE_REJECTION_PROBES &&
+      i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
+  {
+    NwkDuplicateRejectionEntry_t *entry = &nwkRxDuplicateRejectionTable[index];
+
+    if (entry->used && entry->src == src)
+      return entry;
+
+    // Prefer free and expired entries, then the least recently used one
+    if (NULL == victim || (nwkRxDuplicateEntryAlive(victim) &&
+        (!nwkRxDuplicateEntryAlive(entry) || (int32_t)(entry->time - victim->time) < 0)))
+      victim = entry;
+
+    if (++index == NWK_DUPLICATE_REJECTION_TABLE_SIZE)
+      index = 0;
+  }
+
+  if (!create)
+    return NULL;
+
+  victim->used = false;
+  victim->src = src;
+
+  return victim;
+}
+
+/*************************************************************************//**
+  @brief Shifts the duplicate rejection @a window by @a shift sequence numbers
+*****************************************************************************/
+static inline NwkRxWindow_t nwkRxWindowShift(NwkRxWindow_t window, uint8_t shift)
+{
+  return (shift < NWK_DUPLICATE_REJECTION_WINDOW) ? (NwkRxWindow_t)(window << shift) : 0;
+}
+
+/*************************************************************************//**
+  @brief Returns the last accepted attempt of the frame @a diff sequence
+         numbers behind the newest one in the @a entry
+*****************************************************************************/
+static uint8_t nwkRxWindowAttempt(NwkDuplicateRejectionEntry_t *entry, uint8_t diff)
+{
+  return ((entry->attemptLo >> diff) & 1) | (((entry->attemptHi >> diff) & 1) << 1);
+}
+
+/*************************************************************************//**
+  @brief Sets the last accepted attempt of the frame @a diff sequence
+         numbers behind the newest one in the @a entry
+*****************************************************************************/
+static void nwkRxWindowSetAttempt(NwkDuplicateRejectionEntry_t *entry, uint8_t diff, uint8_t attempt)
+{
+  NwkRxWindow_t bit = (NwkRxWindow_t)1 << diff;
+
+  entry->attemptLo = (attempt & 1) ? (entry->attemptLo | bit) : (entry->attemptLo & ~bit);
+  entry->attemptHi = (attempt & 2) ? (entry->attemptHi | bit) : (entry->attemptHi & ~bit);
+}
+
+/*************************************************************************//**
+  @brief Remembers that the frame with @a header was acknowledged, so that
+         its retransmissions are acknowledged again without an indication
+*****************************************************************************/
+static void nwkRxMarkAcked(NwkFrameHeader_t *header)
+{
+  NwkDuplicateRejectionEntry_t *entry = nwkRxDuplicateEntryFind(header->nwkSrcAddr, false);
+
+  if (entry && nwkRxDuplicateEntryAlive(entry))
+  {
+    uint8_t diff = (int8_t)entry->seq - header->nwkSeq;
+
+    if (diff < NWK_DUPLICATE_REJECTION_WINDOW)
+      entry->acked |= (NwkRxWindow_t)1 << diff;
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkRxSendAck(NwkFrame_t *frame)
+{
+  nwkRxMarkAcked(&frame->header);
+
+#ifdef NWK_ENABLE_BLOCK_ACK
+  if (nwkRxCoalesceAck(frame))
+    return;
+#endif
+
+  nwkRxSendAckCommand(frame->header.nwkSrcAddr, frame->header.nwkFcf.security,
+      frame->header.nwkSeq, 0, nwkRxAckControl);
+}
+
 /*************************************************************************//**
 *****************************************************************************/
 void NWK_SetAckControl(uint8_t control)
@@ -164,90 +517,147 @@ void NWK_SetAckControl(uint8_t control)
   nwkRxAckControl = control;
 }
 
-#ifdef NWK_ENABLE_SECURITY
 /*************************************************************************//**
+  @brief Keeps the frame of the indication @a ind after the endpoint handler
+         returns, so that ind->data stays valid until NWK_DataIndRelease().
+         May only be called from the endpoint handler. The handler should
+         still return @c true, the frame is acknowledged at this point.
+         Deferred frames hold RX buffers and keep NWK_Busy() true.
+  @param[in] ind Pointer to the indication passed to the endpoint handler
 *****************************************************************************/
-void nwkRxDecryptConf(NwkFrame_t *frame, bool status)
+void NWK_DataIndDefer(NWK_DataInd_t *ind)
 {
-  if (status)
-    frame->state = NWK_RX_STATE_INDICATE;
-  else
-    frame->state = NWK_RX_STATE_FINISH;
+  if (nwkRxIndFrame)
+    nwkRxIndFrame->rx.deferred++;
+
+  (void)ind;
 }
-#endif
 
 /*************************************************************************//**
+  @brief Returns the frame of the deferred indication @a ind to the buffer
+         pool once every NWK_DataIndDefer() on it has been released. A copy
+         of the original indication structure may be passed.
+  @param[in] ind Pointer to the deferred indication
 *****************************************************************************/
-static void nwkRxDuplicateRejectionTimerHandler(SYS_Timer_t *timer)
+void NWK_DataIndRelease(NWK_DataInd_t *ind)
 {
-  bool restart = false;
+  NwkFrame_t *frame = NULL;
 
-  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
+  while (NULL != (frame = nwkFrameNext(frame)))
   {
-    if (nwkRxDuplicateRejectionTable[i].ttl)
-    {
-      nwkRxDuplicateRejectionTable[i].ttl--;
-      restart = true;
-    }
+    if (NWK_RX_STATE_DEFERRED != frame->state && nwkRxIndFrame != frame)
+      continue;
+
+    if (ind->data < frame->data || ind->data > frame->data + frame->size)
+      continue;
+
+    if (frame->rx.deferred > 0)
+      frame->rx.deferred--;
+
+    if (0 == frame->rx.deferred && NWK_RX_STATE_DEFERRED == frame->state)
+      nwkFrameFree(frame);
+
+    return;
   }
+}
+
+#ifdef NWK_ENABLE_SECURITY
+/*************************************************************************//**
+*****************************************************************************/
+void nwkRxDecryptConf(NwkFrame_t *frame, bool status)
+{
+  if (status)
+    frame->state = NWK_RX_STATE_INDICATE;
+  else
+    frame->state = NWK_RX_STATE_FINISH;
 
-  if (restart)
-    SYS_TimerStart(timer);
+  nwkFrameQueuePush(&nwkRxQueue, frame);
 }
+#endif
 
 /*************************************************************************//**
+  @brief Checks if the frame @a frame was already received, a retransmission
+         of a frame with the ACK request and a higher attempt number is
+         accepted once, or only acknowledged again if the original frame was
+         acknowledged by this node. The attempt number is not covered by the
+         MIC, so a secured retransmission is acknowledged after decryption.
+  @return @c true if the frame must be dropped
 *****************************************************************************/
-static bool nwkRxRejectDuplicate(NwkFrameHeader_t *header)
+static bool nwkRxRejectDuplicate(NwkFrame_t *frame)
 {
-  NwkDuplicateRejectionEntry_t *entry;
-  NwkDuplicateRejectionEntry_t *freeEntry = NULL;
+  NwkFrameHeader_t *header = &frame->header;
+  NwkDuplicateRejectionEntry_t *entry = nwkRxDuplicateEntryFind(header->nwkSrcAddr, true);
 
-  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
+  if (nwkRxDuplicateEntryAlive(entry))
   {
-    entry = &nwkRxDuplicateRejectionTable[i];
+    uint8_t diff = (int8_t)entry->seq - header->nwkSeq;
 
-    if (entry->ttl && header->nwkSrcAddr == entry->src)
+    if (diff < NWK_DUPLICATE_REJECTION_WINDOW)
     {
-      uint8_t diff = (int8_t)entry->seq - header->nwkSeq;
+      NwkRxWindow_t bit = (NwkRxWindow_t)1 << diff;
 
-      if (diff < 8)
+      if (entry->mask & bit)
       {
-        if (entry->mask & (1 << diff))
+        if (header->nwkFcf.ackRequest &&
+            header->nwkFcf.attempt > nwkRxWindowAttempt(entry, diff))
         {
-        #ifdef NWK_ENABLE_ROUTING
-          if (nwkIb.addr == header->macDstAddr)
-            nwkRouteRemove(header->nwkDstAddr, header->nwkFcf.multicast);
+          nwkRxWindowSetAttempt(entry, diff, header->nwkFcf.attempt);
+
+          if (0 == (entry->acked & bit) || nwkIb.addr != header->nwkDstAddr)
+            return false;
+
+        #ifdef NWK_ENABLE_SECURITY
+          if (header->nwkFcf.security)
+          {
+            frame->rx.ackOnly = 1;
+            return false;
+          }
         #endif
+
+          nwkRxAckControl = 0;
+          nwkRxSendAck(frame);
           return true;
         }
 
-        entry->mask |= (1 << diff);
-        return false;
+      #ifdef NWK_ENABLE_ROUTING
+        if (nwkIb.addr == header->macDstAddr)
+          nwkRouteRemove(header->nwkDstAddr, header->nwkFcf.multicast);
+      #endif
+        return true;
       }
-      else
-      {
-        uint8_t shift = -(int8_t)diff;
 
-        entry->seq = header->nwkSeq;
-        entry->mask = (entry->mask << shift) | 1;
-        entry->ttl = DUPLICATE_REJECTION_TTL;
-        return false;
-      }
+      entry->mask |= bit;
+      nwkRxWindowSetAttempt(entry, diff, header->nwkFcf.attempt);
+      return false;
+    }
+    else
+    {
+      uint8_t shift = -(int8_t)diff;
+
+      // A frame older than the window may already be indicated, and moving
+      // the window back would forget the newer frames
+      if ((int8_t)diff > 0)
+        return true;
+
+      entry->seq = header->nwkSeq;
+      entry->mask = nwkRxWindowShift(entry->mask, shift) | 1;
+      entry->acked = nwkRxWindowShift(entry->acked, shift);
+      entry->attemptLo = nwkRxWindowShift(entry->attemptLo, shift);
+      entry->attemptHi = nwkRxWindowShift(entry->attemptHi, shift);
+      nwkRxWindowSetAttempt(entry, 0, header->nwkFcf.attempt);
+      entry->time = SYS_TimerGetTime();
+      return false;
     }
-
-    if (0 == entry->ttl)
-      freeEntry = entry;
   }
 
-  if (NULL == freeEntry)
-    return true;
-
-  freeEntry->src = header->nwkSrcAddr;
-  freeEntry->seq = header->nwkSeq;
-  freeEntry->mask = 1;
-  freeEntry->ttl = DUPLICATE_REJECTION_TTL;
-
-  SYS_TimerStart(&nwkRxDuplicateRejectionTimer);
+  entry->used = true;
+  entry->seq = header->nwkSeq;
+  entry->mask = 1;
+  entry->acked = 0;
+  entry->attemptLo = 0;
+  entry->attemptHi = 0;
+  nwkRxWindowSetAttempt(entry, 0, header->nwkFcf.attempt);
+  entry->time = SYS_TimerGetTime();
 
   return false;
 }
@@ -269,6 +679,11 @@ static bool nwkRxServiceDataInd(NWK_DataInd_t *ind)
     case NWK_COMMAND_ACK:
       return nwkTxAckReceived(ind);
 
+#ifdef NWK_ENABLE_BLOCK_ACK
+    case NWK_COMMAND_BLOCK_ACK:
+      return nwkTxBlockAckReceived(ind);
+#endif
+
 #ifdef NWK_ENABLE_ROUTING
     case NWK_COMMAND_ROUTE_ERROR:
       return nwkRouteErrorReceived(ind);
@@ -330,15 +745,19 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
   if (NWK_BROADCAST_ADDR == header->nwkDstAddr && header->nwkFcf.ackRequest)
     return;
 
-  if (nwkIb.addr == header->nwkSrcAddr)
-    return;
-
 #ifdef NWK_ENABLE_ROUTING
   nwkRouteFrameReceived(frame);
 #endif
 
-  if (nwkRxRejectDuplicate(header))
+  if (nwkRxRejectDuplicate(frame))
+  {
+    nwkIb.stats.duplicatesRejected++;
+  #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+    if (NWK_BROADCAST_ADDR == header->macDstAddr)
+      nwkTxBroadcastCopyReceived(header);
+  #endif
     return;
+  }
 
 #ifdef NWK_ENABLE_MULTICAST
   if (header->nwkFcf.multicast)
@@ -418,6 +837,113 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
   }
 }
 
+#ifdef NWK_ENABLE_AGGREGATION
+/*************************************************************************//**
+  @brief Finds the record of the partially accepted aggregate @a header
+  @param[in] header Header of the received aggregated frame
+  @param[in] create Take over a free, expired or the oldest entry if there
+             is no record for the frame
+  @return Pointer to the entry or NULL if it was not found
+*****************************************************************************/
+static NwkRxAggregateEntry_t *nwkRxAggregateEntryFind(NwkFrameHeader_t *header, bool create)
+{
+  NwkRxAggregateEntry_t *victim = NULL;
+
+  for (uint8_t i = 0; i < NWK_AGGREGATION_RX_TABLE_SIZE; i++)
+  {
+    NwkRxAggregateEntry_t *entry = &nwkRxAggregateTable[i];
+    bool alive = entry->used &&
+        (SYS_TimerGetTime() - entry->time) <= NWK_RX_DUPLICATE_REJECTION_TIME;
+
+    if (alive && header->nwkSrcAddr == entry->src && header->nwkSeq == entry->seq)
+      return entry;
+
+    if (!alive)
+      entry->used = false;
+
+    if (NULL == victim || (victim->used && (!entry->used ||
+        (int32_t)(entry->time - victim->time) < 0)))
+      victim = entry;
+  }
+
+  if (!create)
+    return NULL;
+
+  victim->used = true;
+  victim->src = header->nwkSrcAddr;
+  victim->seq = header->nwkSeq;
+  victim->time = SYS_TimerGetTime();
+  memset(victim->delivered, 0, sizeof(victim->delivered));
+
+  return victim;
+}
+
+/*************************************************************************//**
+  @brief Splits an aggregated frame and indicates each message to its endpoint.
+         When some messages are rejected, the accepted ones are remembered
+         and not indicated again when the sender retries the frame.
+  @param[in] frame Received aggregated frame
+  @param[in] ind Indication prepared for the whole frame payload
+  @return @c true if every message was accepted and the frame can be acknowledged
+*****************************************************************************/
+static bool nwkRxIndicateAggregate(NwkFrame_t *frame, NWK_DataInd_t *ind)
+{
+  NwkRxAggregateEntry_t *entry = nwkRxAggregateEntryFind(&frame->header, false);
+  uint8_t delivered[NWK_RX_AGGREGATE_MASK_SIZE];
+  uint8_t *data = ind->data;
+  uint8_t size = ind->size;
+  bool ack = true;
+
+  if (entry)
+    memcpy(delivered, entry->delivered, sizeof(delivered));
+  else
+    memset(delivered, 0, sizeof(delivered));
+
+  for (uint8_t i = 0; size >= sizeof(NwkFrameAggregateHeader_t); i++)
+  {
+    NwkFrameAggregateHeader_t *sub = (NwkFrameAggregateHeader_t *)data;
+    uint8_t bit = 1 << (i % 8);
+
+    data += sizeof(NwkFrameAggregateHeader_t);
+    size -= sizeof(NwkFrameAggregateHeader_t);
+
+    if (sub->size > size)
+      return false;
+
+    ind->srcEndpoint = sub->srcEndpoint;
+    ind->dstEndpoint = sub->dstEndpoint;
+    ind->data = data;
+    ind->size = sub->size;
+
+    if (0 == (delivered[i / 8] & bit))
+    {
+      if (nwkIb.endpoint[sub->dstEndpoint] && nwkIb.endpoint[sub->dstEndpoint](ind))
+        delivered[i / 8] |= bit;
+      else
+        ack = false;
+    }
+
+    data += sub->size;
+    size -= sub->size;
+  }
+
+  if (ack || 0 == frame->header.nwkFcf.ackRequest)
+  {
+    if (entry)
+      entry->used = false;
+  }
+  else
+  {
+    if (NULL == entry)
+      entry = nwkRxAggregateEntryFind(&frame->header, true);
+
+    memcpy(entry->delivered, delivered, sizeof(delivered));
+  }
+
+  return ack;
+}
+#endif
+
 /*************************************************************************//**
 *****************************************************************************/
 static bool nwkRxIndicateFrame(NwkFrame_t *frame)
@@ -425,7 +951,12 @@ static bool nwkRxIndicateFrame(NwkFrame_t *frame)
   NwkFrameHeader_t *header = &frame->header;
   NWK_DataInd_t ind;
 
-  if (NULL == nwkIb.endpoint[header->nwkDstEndpoint])
+#ifndef NWK_ENABLE_AGGREGATION
+  if (header->nwkFcf.aggregate)
+    return false;
+#endif
+
+  if (0 == header->nwkFcf.aggregate && NULL == nwkIb.endpoint[header->nwkDstEndpoint])
     return false;
 
   ind.srcAddr = header->nwkSrcAddr;
@@ -445,6 +976,11 @@ static bool nwkRxIndicateFrame(NwkFrame_t *frame)
   ind.options |= (header->nwkSrcAddr == header->macSrcAddr) ? NWK_IND_OPT_LOCAL : 0;
   ind.options |= (NWK_BROADCAST_PANID == header->macDstPanId) ? NWK_IND_OPT_BROADCAST_PAN_ID : 0;
 
+#ifdef NWK_ENABLE_AGGREGATION
+  if (header->nwkFcf.aggregate)
+    return nwkRxIndicateAggregate(frame, &ind);
+#endif
+
   return nwkIb.endpoint[header->nwkDstEndpoint](&ind);
 }
 
@@ -454,9 +990,27 @@ static void nwkRxHandleIndication(NwkFrame_t *frame)
 {
   bool ack;
 
+#ifdef NWK_ENABLE_SECURITY
+  if (frame->rx.ackOnly)
+  {
+    nwkIb.stats.duplicatesRejected++;
+    nwkRxAckControl = 0;
+    nwkRxSendAck(frame);
+    frame->state = NWK_RX_STATE_FINISH;
+    return;
+  }
+#endif
+
   nwkRxAckControl = 0;
+  nwkRxIndFrame = frame;
   ack = nwkRxIndicateFrame(frame);
-  
+  nwkRxIndFrame = NULL;
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  if (nwkRxCongested)
+    nwkRxAckControl |= NWK_ACK_CONTROL_CONGESTED;
+#endif
+
   if (0 == frame->header.nwkFcf.ackRequest)
     ack = false;
 
@@ -474,7 +1028,66 @@ static void nwkRxHandleIndication(NwkFrame_t *frame)
   if (ack)
     nwkRxSendAck(frame);
 
-  frame->state = NWK_RX_STATE_FINISH;
+  if (frame->rx.deferred > 0)
+    frame->state = NWK_RX_STATE_DEFERRED;
+  else
+    frame->state = NWK_RX_STATE_FINISH;
+}
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+/*************************************************************************//**
+  @brief Sets the function called when the receiver becomes congested and
+         when it recovers
+  @param[in] handler Pointer to the handler or @c NULL
+*****************************************************************************/
+void NWK_SetCongestionHandler(void (*handler)(bool congested))
+{
+  nwkRxCongestionHandler = handler;
+}
+
+/*************************************************************************//**
+  @brief Enters the congested state when RX buffers reach NWK_RX_HIGH_WATERMARK
+         or a frame was lost for the lack of a buffer, and leaves it when no
+         more than NWK_RX_LOW_WATERMARK buffers are in use
+*****************************************************************************/
+static void nwkRxUpdateCongestion(void)
+{
+  uint8_t used = nwkFrameClassUsed(NWK_BUFFER_CLASS_RX);
+  bool congested = nwkRxCongested;
+
+  if (nwkRxOverflow || used >= NWK_RX_HIGH_WATERMARK)
+    congested = true;
+  else if (used <= NWK_RX_LOW_WATERMARK)
+    congested = false;
+
+  nwkRxOverflow = false;
+
+  if (congested == nwkRxCongested)
+    return;
+
+  nwkRxCongested = congested;
+
+  if (nwkRxCongestionHandler)
+    nwkRxCongestionHandler(congested);
+}
+#endif
+
+/*************************************************************************//**
+  @brief Takes the frame @a frame as far as it goes without waiting, only
+         decryption and routing continue on the next pass of the task handler
+*****************************************************************************/
+static void nwkRxProcessFrame(NwkFrame_t *frame)
+{
+  if (NWK_RX_STATE_RECEIVED == frame->state)
+    nwkRxHandleReceivedFrame(frame);
+
+  if (NWK_RX_STATE_INDICATE == frame->state)
+    nwkRxHandleIndication(frame);
+
+  if (NWK_RX_STATE_FINISH == frame->state)
+    nwkFrameFree(frame);
+  else if (NWK_RX_STATE_DEFERRED != frame->state)
+    nwkFrameQueuePush(&nwkRxQueue, frame);
 }
 
 /*************************************************************************//**
@@ -482,15 +1095,25 @@ static void nwkRxHandleIndication(NwkFrame_t *frame)
 *****************************************************************************/
 void nwkRxTaskHandler(void)
 {
-  NwkFrame_t *frame = NULL;
+  NwkFrameQueue_t queue = nwkRxQueue;
+  NwkFrame_t *frame;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  // Frames queued during this pass are handled on the next one
+  nwkFrameQueueInit(&nwkRxQueue);
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  nwkRxUpdateCongestion();
+#endif
+
+  while (NULL != (frame = nwkFrameQueuePop(&queue)))
   {
     switch (frame->state)
     {
       case NWK_RX_STATE_RECEIVED:
+      case NWK_RX_STATE_INDICATE:
+      case NWK_RX_STATE_FINISH:
       {
-        nwkRxHandleReceivedFrame(frame);
+        nwkRxProcessFrame(frame);
       } break;
 
 #ifdef NWK_ENABLE_SECURITY
@@ -500,22 +1123,12 @@ void nwkRxTaskHandler(void)
       } break;
 #endif
 
-      case NWK_RX_STATE_INDICATE:
-      {
-        nwkRxHandleIndication(frame);
-      } break;
-
 #ifdef NWK_ENABLE_ROUTING
       case NWK_RX_STATE_ROUTE:
       {
         nwkRouteFrame(frame);
       } break;
 #endif
-
-      case NWK_RX_STATE_FINISH:
-      {
-        nwkFrameFree(frame);
-      } break;
     }
   }
 }
@@ -59,11 +59,6 @@
 #include "nwkCommand.h"
 #include "nwkSecurity.h"
 
-/*- Definitions ------------------------------------------------------------*/
-#define NWK_TX_ACK_WAIT_TIMER_INTERVAL    50 // ms
-#define NWK_TX_DELAY_TIMER_INTERVAL       10 // ms
-#define NWK_TX_DELAY_JITTER_MASK          0x07
-
 /*- Types ------------------------------------------------------------------*/
 enum
 {
@@ -85,6 +80,17 @@ static void nwkTxDelayTimerHandler(SYS_Timer_t *timer);
 static NwkFrame_t *nwkTxPhyActiveFrame;
 static SYS_Timer_t nwkTxAckWaitTimer;
 static SYS_Timer_t nwkTxDelayTimer;
+static NwkFrameQueue_t nwkTxQueue;
+static NwkFrameQueue_t nwkTxDelayQueue;
+static NwkFrameQueue_t nwkTxSendQueue[NWK_PRIORITY_LEVELS];
+#ifdef NWK_ENABLE_WEIGHTED_PRIORITY
+static const uint8_t nwkTxPriorityWeights[NWK_PRIORITY_LEVELS] = NWK_PRIORITY_WEIGHTS;
+static uint8_t nwkTxPriorityCredits[NWK_PRIORITY_LEVELS];
+#endif
+static NwkFrameQueue_t nwkTxAckWaitQueue;
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+static uint16_t nwkTxBroadcastJitter;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -95,13 +101,26 @@ void nwkTxInit(void)
 {
   nwkTxPhyActiveFrame = NULL;
 
-  nwkTxAckWaitTimer.interval = NWK_TX_ACK_WAIT_TIMER_INTERVAL;
+  nwkFrameQueueInit(&nwkTxQueue);
+  nwkFrameQueueInit(&nwkTxDelayQueue);
+  for (uint8_t i = 0; i < NWK_PRIORITY_LEVELS; i++)
+  {
+    nwkFrameQueueInit(&nwkTxSendQueue[i]);
+#ifdef NWK_ENABLE_WEIGHTED_PRIORITY
+    nwkTxPriorityCredits[i] = nwkTxPriorityWeights[i];
+#endif
+  }
+  nwkFrameQueueInit(&nwkTxAckWaitQueue);
+
   nwkTxAckWaitTimer.mode = SYS_TIMER_INTERVAL_MODE;
   nwkTxAckWaitTimer.handler = nwkTxAckWaitTimerHandler;
 
-  nwkTxDelayTimer.interval = NWK_TX_DELAY_TIMER_INTERVAL;
   nwkTxDelayTimer.mode = SYS_TIMER_INTERVAL_MODE;
   nwkTxDelayTimer.handler = nwkTxDelayTimerHandler;
+
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+  nwkTxBroadcastJitter = NWK_BROADCAST_JITTER;
+#endif
 }
 
 /*************************************************************************//**
@@ -145,13 +164,17 @@ void nwkTxFrame(NwkFrame_t *frame)
   if (NWK_BROADCAST_ADDR == header->macDstAddr)
   {
     header->macFcf = 0x8841;
-    frame->tx.timeout = (rand() & NWK_TX_DELAY_JITTER_MASK) + 1;
+    frame->tx.timeout = rand() % NWK_BROADCAST_JITTER + 1;
   }
   else
   {
     header->macFcf = 0x8861;
     frame->tx.timeout = 0;
   }
+
+  // Route discovery may have taken the frame over or already confirmed it
+  if (NWK_TX_STATE_DELAY == frame->state || NWK_TX_STATE_ENCRYPT == frame->state)
+    nwkFrameQueuePush(&nwkTxQueue, frame);
 }
 
 /*************************************************************************//**
@@ -160,13 +183,18 @@ void nwkTxBroadcastFrame(NwkFrame_t *frame)
 {
   NwkFrame_t *newFrame;
 
-  if (NULL == (newFrame = nwkFrameAlloc()))
+  if (NULL == (newFrame = nwkFrameAlloc(NWK_BUFFER_CLASS_REBROADCAST, frame->size)))
     return;
 
   newFrame->state = NWK_TX_STATE_DELAY;
   newFrame->size = frame->size;
   newFrame->tx.status = NWK_SUCCESS_STATUS;
-  newFrame->tx.timeout = (rand() & NWK_TX_DELAY_JITTER_MASK) + 1;
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+  newFrame->tx.timeout = rand() % nwkTxBroadcastJitter + 1;
+#else
+  newFrame->tx.timeout = rand() % NWK_BROADCAST_JITTER + 1;
+#endif
+  newFrame->tx.priority = NWK_PRIORITY_ROUTED;
   newFrame->tx.confirm = NULL;
   memcpy(newFrame->data, frame->data, frame->size);
 
@@ -175,6 +203,180 @@ void nwkTxBroadcastFrame(NwkFrame_t *frame)
   newFrame->header.macDstPanId = frame->header.macDstPanId;
   newFrame->header.macSrcAddr = nwkIb.addr;
   newFrame->header.macSeq = ++nwkIb.macSeqNum;
+
+  nwkFrameQueuePush(&nwkTxQueue, newFrame);
+}
+
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+/*************************************************************************//**
+  @brief Adapts the rebroadcast jitter window to the neighbour density, the
+         window grows when a rebroadcast was suppressed and shrinks when no
+         copies were heard before the frame was sent
+*****************************************************************************/
+static void nwkTxBroadcastJitterUpdate(bool suppressed)
+{
+  if (suppressed)
+  {
+    nwkTxBroadcastJitter += nwkTxBroadcastJitter / 4 + 1;
+
+    if (nwkTxBroadcastJitter > NWK_BROADCAST_JITTER * NWK_BROADCAST_JITTER_MAX_SCALE)
+      nwkTxBroadcastJitter = NWK_BROADCAST_JITTER * NWK_BROADCAST_JITTER_MAX_SCALE;
+  }
+  else
+  {
+    nwkTxBroadcastJitter -= nwkTxBroadcastJitter / 4;
+
+    if (nwkTxBroadcastJitter < NWK_BROADCAST_JITTER)
+      nwkTxBroadcastJitter = NWK_BROADCAST_JITTER;
+  }
+}
+
+/*************************************************************************//**
+  @brief Counts a copy of the frame with the @a header against the pending
+         rebroadcast in the @a queue and cancels the rebroadcast once enough
+         copies were heard from the neighbours
+  @return true if the pending rebroadcast was found in the @a queue
+*****************************************************************************/
+static bool nwkTxBroadcastSuppress(NwkFrameQueue_t *queue, NwkFrameHeader_t *header)
+{
+  for (NwkFrame_t *frame = queue->head; frame; frame = frame->next)
+  {
+    if (NWK_BUFFER_CLASS_REBROADCAST != frame->bufferClass ||
+        (NWK_TX_STATE_WAIT_DELAY != frame->state && NWK_TX_STATE_DELAY != frame->state) ||
+        frame->header.nwkSrcAddr != header->nwkSrcAddr ||
+        frame->header.nwkSeq != header->nwkSeq)
+      continue;
+
+    if (++frame->tx.copies >= NWK_BROADCAST_SUPPRESSION_COPIES)
+    {
+      nwkFrameQueueRemove(queue, frame);
+      nwkFrameFree(frame);
+      nwkTxBroadcastJitterUpdate(true);
+      nwkIb.stats.broadcastsSuppressed++;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+/*************************************************************************//**
+  @brief Notifies the Tx module that a copy of the broadcast frame with the
+         @a header was heard from a neighbour
+*****************************************************************************/
+void nwkTxBroadcastCopyReceived(NwkFrameHeader_t *header)
+{
+  // Rebroadcasts created during the current Rx pass are still in nwkTxQueue
+  if (!nwkTxBroadcastSuppress(&nwkTxDelayQueue, header))
+    nwkTxBroadcastSuppress(&nwkTxQueue, header);
+}
+#endif
+
+/*************************************************************************//**
+  @brief Checks if the deadline of the frame @a frame has passed
+*****************************************************************************/
+static bool nwkTxDeadlineExpired(NwkFrame_t *frame)
+{
+  return (int32_t)(frame->tx.timeout - SYS_TimerGetTime()) <= 0;
+}
+
+/*************************************************************************//**
+  @brief Arms the @a timer for the earliest deadline in the @a queue
+*****************************************************************************/
+static void nwkTxDeadlineTimerStart(NwkFrameQueue_t *queue, SYS_Timer_t *timer)
+{
+  NwkFrame_t *frame = queue->head;
+
+  if (frame)
+  {
+    timer->interval = nwkTxDeadlineExpired(frame) ? 0 :
+        frame->tx.timeout - SYS_TimerGetTime();
+    SYS_TimerStart(timer);
+  }
+}
+
+/*************************************************************************//**
+  @brief Returns the deadline of the frame @a frame moved behind the delayed
+         frames queued earlier with the same source and destination. The
+         broadcast jitter would otherwise reorder them by more than the
+         duplicate rejection window of the receivers. Rebroadcasts keep
+         their jitter, their copies arrive over several paths anyway.
+*****************************************************************************/
+static uint32_t nwkTxFlowDeadline(NwkFrame_t *frame, uint32_t deadline)
+{
+  if (NWK_BUFFER_CLASS_REBROADCAST == frame->bufferClass)
+    return deadline;
+
+  for (NwkFrame_t *iter = nwkTxDelayQueue.head; iter; iter = iter->next)
+  {
+    if (iter->header.nwkSrcAddr == frame->header.nwkSrcAddr &&
+        iter->header.nwkDstAddr == frame->header.nwkDstAddr &&
+        (int32_t)(iter->tx.timeout - deadline) > 0)
+      deadline = iter->tx.timeout;
+  }
+
+  return deadline;
+}
+
+/*************************************************************************//**
+  @brief Inserts the frame @a frame into the @a queue ordered by deadline and
+         rearms the @a timer if the frame became the earliest one
+*****************************************************************************/
+static void nwkTxDeadlineQueueInsert(NwkFrameQueue_t *queue, SYS_Timer_t *timer,
+    NwkFrame_t *frame)
+{
+  NwkFrame_t *prev = NULL;
+  NwkFrame_t *iter = queue->head;
+
+  while (iter && (int32_t)(frame->tx.timeout - iter->tx.timeout) >= 0)
+  {
+    prev = iter;
+    iter = iter->next;
+  }
+
+  frame->next = iter;
+
+  if (prev)
+    prev->next = frame;
+  else
+    queue->head = frame;
+
+  if (NULL == iter)
+    queue->tail = frame;
+
+  if (queue->head == frame)
+  {
+    SYS_TimerStop(timer);
+    nwkTxDeadlineTimerStart(queue, timer);
+  }
+}
+
+/*************************************************************************//**
+  @brief Confirms the frame @a frame waiting for an acknowledgement in the
+         @a queue
+*****************************************************************************/
+static void nwkTxAcknowledged(NwkFrameQueue_t *queue, NwkFrame_t *frame, uint8_t control)
+{
+  nwkFrameQueueRemove(queue, frame);
+
+#ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+  // The sample is ambiguous for retransmitted frames (Karn's algorithm)
+  if (0 == frame->header.nwkFcf.attempt && &nwkTxAckWaitQueue == queue)
+    nwkRouteAckReceived(frame->header.nwkDstAddr, frame->header.nwkFcf.multicast,
+        (uint16_t)SYS_TimerGetTime() - frame->tx.sentTime);
+#endif
+
+  frame->tx.control = control;
+  nwkTxConfirm(frame, NWK_SUCCESS_STATUS);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static bool nwkTxAckPending(NwkFrame_t *frame)
+{
+  return NWK_TX_STATE_SENT == frame->state && NWK_SUCCESS_STATUS == frame->tx.status &&
+      frame->header.nwkFcf.ackRequest && frame->header.nwkSrcAddr == nwkIb.addr;
 }
 
 /*************************************************************************//**
@@ -182,17 +384,26 @@ void nwkTxBroadcastFrame(NwkFrame_t *frame)
 bool nwkTxAckReceived(NWK_DataInd_t *ind)
 {
   NwkCommandAck_t *command = (NwkCommandAck_t *)ind->data;
-  NwkFrame_t *frame = NULL;
 
   if (sizeof(NwkCommandAck_t) != ind->size)
     return false;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  for (NwkFrame_t *frame = nwkTxAckWaitQueue.head; frame; frame = frame->next)
   {
-    if (NWK_TX_STATE_WAIT_ACK == frame->state && frame->header.nwkSeq == command->seq)
+    if (frame->header.nwkSeq == command->seq)
     {
-      frame->state = NWK_TX_STATE_CONFIRM;
-      frame->tx.control = command->control;
+      nwkTxAcknowledged(&nwkTxAckWaitQueue, frame, command->control);
+      return true;
+    }
+  }
+
+  // Received frames are indicated in the same pass, so the acknowledgement
+  // may overtake the confirmation of the frame
+  for (NwkFrame_t *frame = nwkTxQueue.head; frame; frame = frame->next)
+  {
+    if (nwkTxAckPending(frame) && frame->header.nwkSeq == command->seq)
+    {
+      nwkTxAcknowledged(&nwkTxQueue, frame, command->control);
       return true;
     }
   }
@@ -200,26 +411,87 @@ bool nwkTxAckReceived(NWK_DataInd_t *ind)
   return false;
 }
 
+#ifdef NWK_ENABLE_BLOCK_ACK
 /*************************************************************************//**
+  @brief Confirms all frames to the originator of the block acknowledgement
+         @a ind that are covered by its sequence number and bitmap
 *****************************************************************************/
-static void nwkTxAckWaitTimerHandler(SYS_Timer_t *timer)
+bool nwkTxBlockAckReceived(NWK_DataInd_t *ind)
 {
-  NwkFrame_t *frame = NULL;
-  bool restart = false;
+  NwkCommandBlockAck_t *command = (NwkCommandBlockAck_t *)ind->data;
+  NwkFrameQueue_t *queues[] = { &nwkTxAckWaitQueue, &nwkTxQueue };
+  bool acked = false;
+
+  if (sizeof(NwkCommandBlockAck_t) != ind->size)
+    return false;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  for (uint8_t i = 0; i < 2; i++)
   {
-    if (NWK_TX_STATE_WAIT_ACK == frame->state)
+    NwkFrame_t *frame = queues[i]->head;
+
+    while (frame)
     {
-      restart = true;
+      NwkFrame_t *next = frame->next;
+      uint8_t diff = command->seq - frame->header.nwkSeq;
+
+      if ((&nwkTxAckWaitQueue == queues[i] || nwkTxAckPending(frame)) &&
+          frame->header.nwkDstAddr == ind->srcAddr &&
+          (0 == diff || (diff <= 8 && (command->mask & (1 << (diff - 1))))))
+      {
+        nwkTxAcknowledged(queues[i], frame, command->control);
+        acked = true;
+      }
 
-      if (0 == --frame->tx.timeout)
-        nwkTxConfirm(frame, NWK_NO_ACK_STATUS);
+      frame = next;
     }
   }
 
-  if (restart)
-    SYS_TimerStart(timer);
+  return acked;
+}
+#endif
+
+#if NWK_ACK_RETRIES > 0
+/*************************************************************************//**
+  @brief Sends the frame @a frame again after an exponential backoff with
+         jitter, the frame is already built and encrypted, so only the MAC
+         sequence number and the attempt counter are updated
+*****************************************************************************/
+static void nwkTxRetryFrame(NwkFrame_t *frame)
+{
+  uint16_t backoff = NWK_ACK_RETRY_BACKOFF << frame->header.nwkFcf.attempt;
+
+  frame->header.nwkFcf.attempt++;
+  frame->header.macSeq = ++nwkIb.macSeqNum;
+
+  frame->state = NWK_TX_STATE_DELAY;
+  frame->tx.status = NWK_SUCCESS_STATUS;
+  frame->tx.timeout = backoff + rand() % backoff;
+
+  nwkFrameQueuePush(&nwkTxQueue, frame);
+}
+#endif
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkTxAckWaitTimerHandler(SYS_Timer_t *timer)
+{
+  NwkFrame_t *frame;
+
+  while (NULL != (frame = nwkTxAckWaitQueue.head) && nwkTxDeadlineExpired(frame))
+  {
+    nwkFrameQueuePop(&nwkTxAckWaitQueue);
+  #ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+    nwkRouteAckTimeout(frame->header.nwkDstAddr, frame->header.nwkFcf.multicast);
+  #endif
+  #if NWK_ACK_RETRIES > 0
+    if (frame->header.nwkFcf.attempt < NWK_ACK_RETRIES)
+      nwkTxRetryFrame(frame);
+    else
+  #endif
+      nwkTxConfirm(frame, NWK_NO_ACK_STATUS);
+  }
+
+  nwkTxDeadlineTimerStart(&nwkTxAckWaitQueue, timer);
 }
 
 /*************************************************************************//**
@@ -228,6 +500,7 @@ void nwkTxConfirm(NwkFrame_t *frame, uint8_t status)
 {
   frame->state = NWK_TX_STATE_CONFIRM;
   frame->tx.status = status;
+  nwkFrameQueuePush(&nwkTxQueue, frame);
 }
 
 #ifdef NWK_ENABLE_SECURITY
@@ -236,6 +509,7 @@ void nwkTxConfirm(NwkFrame_t *frame, uint8_t status)
 void nwkTxEncryptConf(NwkFrame_t *frame)
 {
   frame->state = NWK_TX_STATE_DELAY;
+  nwkFrameQueuePush(&nwkTxQueue, frame);
 }
 #endif
 
@@ -243,22 +517,26 @@ void nwkTxEncryptConf(NwkFrame_t *frame)
 *****************************************************************************/
 static void nwkTxDelayTimerHandler(SYS_Timer_t *timer)
 {
-  NwkFrame_t *frame = NULL;
-  bool restart = false;
+  NwkFrame_t *frame;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  while (NULL != (frame = nwkTxDelayQueue.head) && nwkTxDeadlineExpired(frame))
   {
-    if (NWK_TX_STATE_WAIT_DELAY == frame->state)
-    {
-      restart = true;
+    nwkFrameQueuePop(&nwkTxDelayQueue);
 
-      if (0 == --frame->tx.timeout)
-        frame->state = NWK_TX_STATE_SEND;
+  #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+    if (NWK_BUFFER_CLASS_REBROADCAST == frame->bufferClass)
+    {
+      if (0 == frame->tx.copies)
+        nwkTxBroadcastJitterUpdate(false);
+      nwkIb.stats.broadcastsRelayed++;
     }
+  #endif
+
+    frame->state = NWK_TX_STATE_SEND;
+    nwkFrameQueuePush(&nwkTxSendQueue[frame->tx.priority], frame);
   }
 
-  if (restart)
-    SYS_TimerStart(timer);
+  nwkTxDeadlineTimerStart(&nwkTxDelayQueue, timer);
 }
 
 /*************************************************************************//**
@@ -287,18 +565,60 @@ void PHY_DataConf(uint8_t status)
 {
   nwkTxPhyActiveFrame->tx.status = nwkTxConvertPhyStatus(status);
   nwkTxPhyActiveFrame->state = NWK_TX_STATE_SENT;
+  nwkFrameQueuePush(&nwkTxQueue, nwkTxPhyActiveFrame);
   nwkTxPhyActiveFrame = NULL;
   nwkIb.lock--;
 }
 
+/*************************************************************************//**
+  @brief Selects the next frame to be sent from the per-priority send queues
+  @return Pointer to the frame or NULL if there is nothing to send
+
+  Strict selection always serves the highest non-empty priority. Weighted
+  selection gives each priority NWK_PRIORITY_WEIGHTS frames per round, so
+  a busy higher priority can not starve the lower ones.
+*****************************************************************************/
+static NwkFrame_t *nwkTxSelectFrame(void)
+{
+#ifdef NWK_ENABLE_WEIGHTED_PRIORITY
+  for (uint8_t round = 0; round < 2; round++)
+  {
+    for (int8_t i = NWK_PRIORITY_LEVELS - 1; i >= 0; i--)
+    {
+      if (nwkTxPriorityCredits[i] && !nwkFrameQueueEmpty(&nwkTxSendQueue[i]))
+      {
+        nwkTxPriorityCredits[i]--;
+        return nwkFrameQueuePop(&nwkTxSendQueue[i]);
+      }
+    }
+
+    // All backlogged priorities used up their share, start a new round
+    for (uint8_t i = 0; i < NWK_PRIORITY_LEVELS; i++)
+      nwkTxPriorityCredits[i] = nwkTxPriorityWeights[i];
+  }
+#else
+  for (int8_t i = NWK_PRIORITY_LEVELS - 1; i >= 0; i--)
+  {
+    if (!nwkFrameQueueEmpty(&nwkTxSendQueue[i]))
+      return nwkFrameQueuePop(&nwkTxSendQueue[i]);
+  }
+#endif
+
+  return NULL;
+}
+
 /*************************************************************************//**
   @brief Tx Module task handler
 *****************************************************************************/
 void nwkTxTaskHandler(void)
 {
-  NwkFrame_t *frame = NULL;
+  NwkFrameQueue_t queue = nwkTxQueue;
+  NwkFrame_t *frame;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  // Frames queued during this pass are handled on the next one
+  nwkFrameQueueInit(&nwkTxQueue);
+
+  while (NULL != (frame = nwkFrameQueuePop(&queue)))
   {
     switch (frame->state)
     {
@@ -311,31 +631,21 @@ void nwkTxTaskHandler(void)
 
       case NWK_TX_STATE_DELAY:
       {
-        if (frame->tx.timeout > 0)
+        uint32_t deadline = nwkTxFlowDeadline(frame, SYS_TimerGetTime() + frame->tx.timeout);
+
+        if ((int32_t)(deadline - SYS_TimerGetTime()) > 0)
         {
           frame->state = NWK_TX_STATE_WAIT_DELAY;
-          SYS_TimerStart(&nwkTxDelayTimer);
+          frame->tx.timeout = deadline;
+          nwkTxDeadlineQueueInsert(&nwkTxDelayQueue, &nwkTxDelayTimer, frame);
         }
         else
         {
           frame->state = NWK_TX_STATE_SEND;
+          nwkFrameQueuePush(&nwkTxSendQueue[frame->tx.priority], frame);
         }
       } break;
 
-      case NWK_TX_STATE_SEND:
-      {
-        if (NULL == nwkTxPhyActiveFrame)
-        {
-          nwkTxPhyActiveFrame = frame;
-          frame->state = NWK_TX_STATE_WAIT_CONF;
-          PHY_DataReq(frame->data, frame->size);
-          nwkIb.lock++;
-        }
-      } break;
-
-      case NWK_TX_STATE_WAIT_CONF:
-        break;
-
       case NWK_TX_STATE_SENT:
       {
         if (NWK_SUCCESS_STATUS == frame->tx.status)
@@ -343,23 +653,26 @@ void nwkTxTaskHandler(void)
           if (frame->header.nwkSrcAddr == nwkIb.addr && frame->header.nwkFcf.ackRequest)
           {
             frame->state = NWK_TX_STATE_WAIT_ACK;
-            frame->tx.timeout = NWK_ACK_WAIT_TIME / NWK_TX_ACK_WAIT_TIMER_INTERVAL + 1;
-            SYS_TimerStart(&nwkTxAckWaitTimer);
+          #ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+            frame->tx.sentTime = SYS_TimerGetTime();
+            frame->tx.timeout = SYS_TimerGetTime() + nwkRouteAckWaitTime(
+                frame->header.nwkDstAddr, frame->header.nwkFcf.multicast);
+          #else
+            frame->tx.timeout = SYS_TimerGetTime() + NWK_ACK_WAIT_TIME;
+          #endif
+            nwkTxDeadlineQueueInsert(&nwkTxAckWaitQueue, &nwkTxAckWaitTimer, frame);
           }
           else
           {
-            frame->state = NWK_TX_STATE_CONFIRM;
+            nwkTxConfirm(frame, NWK_SUCCESS_STATUS);
           }
         }
         else
         {
-          frame->state = NWK_TX_STATE_CONFIRM;
-	}
+          nwkTxConfirm(frame, frame->tx.status);
+        }
       } break;
 
-      case NWK_TX_STATE_WAIT_ACK:
-        break;
-
       case NWK_TX_STATE_CONFIRM:
       {
 #ifdef NWK_ENABLE_ROUTING
@@ -375,4 +688,12 @@ void nwkTxTaskHandler(void)
         break;
     };
   }
+
+  if (NULL == nwkTxPhyActiveFrame && NULL != (frame = nwkTxSelectFrame()))
+  {
+    nwkTxPhyActiveFrame = frame;
+    frame->state = NWK_TX_STATE_WAIT_CONF;
+    PHY_DataReq(frame->data, frame->size);
+    nwkIb.lock++;
+  }
 }
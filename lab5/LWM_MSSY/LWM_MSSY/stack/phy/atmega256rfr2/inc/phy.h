@@ -59,12 +59,17 @@
 #define PHY_HAS_AES_MODULE
 
 /*- Types ------------------------------------------------------------------*/
+// Data points directly into the transceiver frame buffer (or into the RX
+// queue entry) and is only valid until PHY_DataInd() returns
 typedef struct PHY_DataInd_t
 {
   uint8_t    *data;
   uint8_t    size;
   uint8_t    lqi;
   int8_t     rssi;
+#ifdef PHY_ENABLE_RX_QUEUE
+  uint32_t   timestamp; // symbol counter at the SFD, 16 us units
+#endif
 } PHY_DataInd_t;
 
 enum
@@ -89,6 +94,7 @@ void PHY_DataReq(uint8_t *data, uint8_t size);
 void PHY_DataConf(uint8_t status);
 void PHY_DataInd(PHY_DataInd_t *ind);
 void PHY_TaskHandler(void);
+uint16_t PHY_GetRxErrors(void);
 
 #ifdef PHY_ENABLE_RANDOM_NUMBER_GENERATOR
 uint16_t PHY_RandomReq(void);
@@ -96,10 +102,18 @@ uint16_t PHY_RandomReq(void);
 
 #ifdef PHY_ENABLE_AES_MODULE
 void PHY_EncryptReq(uint8_t *text, uint8_t *key);
+void PHY_EncryptFrameReq(uint8_t *vector, uint8_t *text, uint8_t size,
+    uint8_t *key, bool encrypt);
+void PHY_EncryptFrameConf(void);
+uint16_t PHY_GetEncryptLatency(void);
 #endif
 
 #ifdef PHY_ENABLE_ENERGY_DETECTION
 int8_t PHY_EdReq(void);
 #endif
 
+#ifdef PHY_ENABLE_RX_QUEUE
+uint16_t PHY_GetRxOverflows(void);
+#endif
+
 #endif // _PHY_H_
@@ -56,6 +56,9 @@
 #define PHY_CRC_SIZE          2
 #define TRX_RPC_REG_VALUE     0xeb
 #define IRQ_CLEAR_VALUE       0xff
+#define IRQ_RX_END_VALUE      0x08
+#define PHY_MAX_FRAME_SIZE    127
+#define PHY_MIN_FRAME_SIZE    (3/*fcf + seq*/ + PHY_CRC_SIZE)
 
 /*- Types ------------------------------------------------------------------*/
 typedef enum
@@ -63,20 +66,51 @@ typedef enum
   PHY_STATE_INITIAL,
   PHY_STATE_IDLE,
   PHY_STATE_SLEEP,
+  PHY_STATE_TX_WAIT_ON,
   PHY_STATE_TX_WAIT_END,
 } PhyState_t;
 
+#ifdef PHY_ENABLE_RX_QUEUE
+typedef struct PhyRxFrame_t
+{
+  uint8_t    size;
+  uint8_t    lqi;
+  int8_t     rssi;
+  uint32_t   timestamp;
+  uint8_t    data[PHY_MAX_FRAME_SIZE];
+} PhyRxFrame_t;
+#endif
+
 /*- Prototypes -------------------------------------------------------------*/
 static void phyTrxSetState(uint8_t state);
+static bool phyTrxStep(uint8_t state);
 static void phySetChannel(void);
 static void phySetRxState(void);
 
 /*- Variables --------------------------------------------------------------*/
 static PhyState_t phyState = PHY_STATE_INITIAL;
-static uint8_t phyRxBuffer[128];
 static bool phyRxState;
+static volatile bool phyRxAckPending;
+static uint8_t *phyTxData;
+static uint8_t phyTxSize;
 static uint8_t phyChannel;
 static uint8_t phyBand;
+static volatile uint16_t phyRxErrors;
+#ifdef PHY_ENABLE_RX_QUEUE
+static PhyRxFrame_t phyRxQueue[PHY_RX_QUEUE_SIZE];
+static volatile uint8_t phyRxQueueHead;
+static volatile uint8_t phyRxQueueTail;
+static volatile uint16_t phyRxOverflows;
+#endif
+#ifdef PHY_ENABLE_AES_MODULE
+static uint8_t *phyAesVector;
+static uint8_t *phyAesText;
+static uint8_t phyAesSize;
+static bool phyAesEncrypt;
+static volatile bool phyAesDone;
+static uint16_t phyAesStartTime;
+static uint16_t phyAesLatency;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -87,6 +121,8 @@ void PHY_Init(void)
   TRXPR_REG_s.trxrst = 1;
 
   phyRxState = false;
+  phyRxAckPending = false;
+  phyRxErrors = 0;
   phyBand = 0;
   phyState = PHY_STATE_IDLE;
 
@@ -96,6 +132,26 @@ void PHY_Init(void)
 
   TRX_CTRL_2_REG_s.rxSafeMode = 1;
 
+#if defined(PHY_ENABLE_RX_QUEUE) || defined(PHY_ENABLE_AES_MODULE)
+  SCCR0_REG_s.scen = 1;
+#endif
+
+#ifdef PHY_ENABLE_RX_QUEUE
+  phyRxQueueHead = 0;
+  phyRxQueueTail = 0;
+  phyRxOverflows = 0;
+
+  SCCR0_REG_s.sctse = 1;
+
+  IRQ_STATUS_REG = IRQ_CLEAR_VALUE;
+  IRQ_MASK_REG_s.rxEndEn = 1;
+#endif
+
+#ifdef PHY_ENABLE_AES_MODULE
+  phyAesDone = false;
+  phyAesLatency = 0;
+#endif
+
 #ifdef PHY_ENABLE_RANDOM_NUMBER_GENERATOR
   CSMA_SEED_0_REG = (uint8_t)PHY_RandomReq();
 #endif
@@ -170,21 +226,34 @@ void PHY_Sleep(void)
 void PHY_Wakeup(void)
 {
   TRXPR_REG_s.slptr = 0;
-  phySetRxState();
   phyState = PHY_STATE_IDLE;
+  phySetRxState();
 }
 
 /*************************************************************************//**
+  @brief Starts the transition to TX_ARET_ON and returns, the frame @a data
+         is copied into the frame buffer and sent from PHY_TaskHandler()
+         once the transceiver can no longer receive, so @a data must stay
+         valid until PHY_DataConf()
 *****************************************************************************/
 void PHY_DataReq(uint8_t *data, uint8_t size)
 {
-  phyTrxSetState(TRX_CMD_TX_ARET_ON);
+  phyTxData = data;
+  phyTxSize = size;
+  phyState = PHY_STATE_TX_WAIT_ON;
+
+  phyTrxStep(TRX_STATUS_TX_ARET_ON);
+}
 
+/*************************************************************************//**
+*****************************************************************************/
+static void phyTxStart(void)
+{
   IRQ_STATUS_REG = IRQ_CLEAR_VALUE;
 
-  TRX_FRAME_BUFFER(0) = size + PHY_CRC_SIZE;
-  for (uint8_t i = 0; i < size; i++)
-    TRX_FRAME_BUFFER(i+1) = data[i];
+  TRX_FRAME_BUFFER(0) = phyTxSize + PHY_CRC_SIZE;
+  for (uint8_t i = 0; i < phyTxSize; i++)
+    TRX_FRAME_BUFFER(i+1) = phyTxData[i];
 
   phyState = PHY_STATE_TX_WAIT_END;
   TRX_STATE_REG = TRX_CMD_TX_START;
@@ -237,6 +306,92 @@ void PHY_EncryptReq(uint8_t *text, uint8_t *key)
   for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
     text[i] = AES_STATE;
 }
+
+/*************************************************************************//**
+*****************************************************************************/
+static uint16_t phySymbolCounter(void)
+{
+  uint8_t low = SCCNT_REG(0);  // Latches the upper bytes
+
+  return ((uint16_t)SCCNT_REG(1) << 8) | low;
+}
+
+/*************************************************************************//**
+  @brief Encrypts or decrypts @a size bytes of @a text in place in CFB mode
+         with the initial @a vector, the @a vector is updated with every
+         block. The key is loaded once and the blocks are chained from the
+         AES_READY interrupt, PHY_EncryptFrameConf() is called from
+         PHY_TaskHandler() when the last block is done.
+*****************************************************************************/
+void PHY_EncryptFrameReq(uint8_t *vector, uint8_t *text, uint8_t size,
+    uint8_t *key, bool encrypt)
+{
+  for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
+    AES_KEY = key[i];
+
+  phyAesVector = vector;
+  phyAesText = text;
+  phyAesSize = size;
+  phyAesEncrypt = encrypt;
+  phyAesStartTime = phySymbolCounter();
+
+  AES_CTRL = (1<<AES_CTRL_IM) | (0<<AES_CTRL_DIR) | (0<<AES_CTRL_MODE);
+
+  for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
+    AES_STATE = vector[i];
+
+  AES_CTRL |= (1<<AES_CTRL_REQUEST);
+}
+
+/*************************************************************************//**
+  @brief Returns the time it took to process the last frame in microseconds,
+         measured with the symbol counter in 16 us steps
+*****************************************************************************/
+uint16_t PHY_GetEncryptLatency(void)
+{
+  return phyAesLatency;
+}
+
+/*************************************************************************//**
+  @brief Combines the key stream block with the text and starts the next
+         block, the ciphertext is the input for the next block in CFB mode
+*****************************************************************************/
+ISR(TRX24_AES_READY_vect)
+{
+  uint8_t block = (phyAesSize < AES_BLOCK_SIZE) ? phyAesSize : AES_BLOCK_SIZE;
+
+  (void)AES_STATUS;
+
+  for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
+    phyAesVector[i] = AES_STATE;
+
+  for (uint8_t i = 0; i < block; i++)
+  {
+    phyAesText[i] ^= phyAesVector[i];
+
+    if (phyAesEncrypt)
+      phyAesVector[i] = phyAesText[i];
+    else
+      phyAesVector[i] ^= phyAesText[i];
+  }
+
+  phyAesText += block;
+  phyAesSize -= block;
+
+  if (phyAesSize > 0)
+  {
+    for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++)
+      AES_STATE = phyAesVector[i];
+
+    AES_CTRL |= (1<<AES_CTRL_REQUEST);
+  }
+  else
+  {
+    AES_CTRL = 0;
+    phyAesLatency = (phySymbolCounter() - phyAesStartTime) * 16;
+    phyAesDone = true;
+  }
+}
 #endif
 
 #ifdef PHY_ENABLE_ENERGY_DETECTION
@@ -273,16 +428,130 @@ static void phySetChannel(void)
 }
 
 /*************************************************************************//**
+  @brief Moves an idle transceiver towards the requested receiver state, a
+         transmission in progress applies it once it is confirmed
 *****************************************************************************/
 static void phySetRxState(void)
 {
-  phyTrxSetState(TRX_CMD_TRX_OFF);
+  if (PHY_STATE_IDLE == phyState)
+    phyTrxStep(phyRxState ? TRX_STATUS_RX_AACK_ON : TRX_STATUS_TRX_OFF);
+}
 
-  IRQ_STATUS_REG = IRQ_CLEAR_VALUE;
+/*************************************************************************//**
+  @brief Issues the next command on the way to the transceiver @a state
+  @return @c true if the transceiver is already in the @a state
+
+  RX_AACK_ON and TX_ARET_ON are entered through PLL_ON, so the PLL stays
+  locked between reception and transmission and each step completes in
+  about 1 us. Instead of waiting for it the status is checked again on the
+  next call from PHY_TaskHandler().
+*****************************************************************************/
+static bool phyTrxStep(uint8_t state)
+{
+  bool done = false;
+
+  // RX_END may be handled in the interrupt, it must not slip in between
+  // checking for a pending acknowledgement and forcing a new state
+  ATOMIC_SECTION_ENTER
+    uint8_t status = TRX_STATUS_REG_s.trxStatus;
+
+    if (TRX_STATUS_BUSY_RX_AACK != status)
+      phyRxAckPending = false;
+
+    if (state == status)
+      done = true;
+
+    // Wait for a pending transition and for the acknowledgement of the
+    // last received frame, a forced state change would abort it
+    else if (TRX_STATUS_STATE_TRANSITION_IN_PROGRESS == status ||
+        TRX_STATUS_SLEEP == status || phyRxAckPending)
+      done = false;
+    else if (TRX_STATUS_TRX_OFF == state)
+      TRX_STATE_REG = TRX_CMD_FORCE_TRX_OFF;
+    else if (TRX_STATUS_PLL_ON == status)
+      TRX_STATE_REG = state;
+    else if (TRX_STATUS_TRX_OFF == status)
+      TRX_STATE_REG = TRX_CMD_PLL_ON;
+    else
+      TRX_STATE_REG = TRX_CMD_FORCE_PLL_ON;
+  ATOMIC_SECTION_LEAVE
+
+  return done;
+}
+
+/*************************************************************************//**
+  @brief Returns the number of received frames dropped because they were too
+         short to hold a MAC header and the CRC
+*****************************************************************************/
+uint16_t PHY_GetRxErrors(void)
+{
+  uint16_t errors;
+
+  ATOMIC_SECTION_ENTER
+    errors = phyRxErrors;
+  ATOMIC_SECTION_LEAVE
+
+  return errors;
+}
+
+#ifdef PHY_ENABLE_RX_QUEUE
+/*************************************************************************//**
+  @brief Returns the number of received frames dropped because the RX queue
+         was full
+*****************************************************************************/
+uint16_t PHY_GetRxOverflows(void)
+{
+  uint16_t overflows;
+
+  ATOMIC_SECTION_ENTER
+    overflows = phyRxOverflows;
+  ATOMIC_SECTION_LEAVE
+
+  return overflows;
+}
+
+/*************************************************************************//**
+  @brief Moves the received frame out of the transceiver, so the next frame
+         can be received while the main loop is busy. The queue has a single
+         producer (this handler) and a single consumer (PHY_TaskHandler()),
+         each index is written by one side only.
+*****************************************************************************/
+ISR(TRX24_RX_END_vect)
+{
+  uint8_t head = phyRxQueueHead;
+  uint8_t size = TST_RX_LENGTH_REG;
+
+  IRQ_STATUS_REG = IRQ_RX_END_VALUE;
+
+  if (size < PHY_MIN_FRAME_SIZE)
+  {
+    phyRxErrors++;
+  }
+  else if ((uint8_t)(head - phyRxQueueTail) < PHY_RX_QUEUE_SIZE)
+  {
+    PhyRxFrame_t *frame = &phyRxQueue[head % PHY_RX_QUEUE_SIZE];
+
+    frame->size = size - PHY_CRC_SIZE;
+    for (uint8_t i = 0; i < frame->size; i++)
+      frame->data[i] = TRX_FRAME_BUFFER(i);
+    frame->lqi = TRX_FRAME_BUFFER(size);
+    frame->rssi = (int8_t)PHY_ED_LEVEL_REG + PHY_RSSI_BASE_VAL;
+    frame->timestamp = SCTSR_REG(0) | ((uint32_t)SCTSR_REG(1) << 8) |
+        ((uint32_t)SCTSR_REG(2) << 16) | ((uint32_t)SCTSR_REG(3) << 24);
+
+    phyRxQueueHead = head + 1;
+  }
+  else
+  {
+    phyRxOverflows++;
+  }
+
+  phyRxAckPending = true;
 
-  if (phyRxState)
-    phyTrxSetState(TRX_CMD_RX_AACK_ON);
+  TRX_CTRL_2_REG_s.rxSafeMode = 0;
+  TRX_CTRL_2_REG_s.rxSafeMode = 1;
 }
+#endif
 
 /*************************************************************************//**
 *****************************************************************************/
@@ -299,31 +568,76 @@ static void phyTrxSetState(uint8_t state)
 *****************************************************************************/
 void PHY_TaskHandler(void)
 {
+#ifdef PHY_ENABLE_AES_MODULE
+  if (phyAesDone)
+  {
+    phyAesDone = false;
+    PHY_EncryptFrameConf();
+  }
+#endif
+
   if (PHY_STATE_SLEEP == phyState)
     return;
 
+#ifdef PHY_ENABLE_RX_QUEUE
+  // Deliver everything received since the last call in one batch
+  while (phyRxQueueTail != phyRxQueueHead)
+  {
+    PhyRxFrame_t *frame = &phyRxQueue[phyRxQueueTail % PHY_RX_QUEUE_SIZE];
+    PHY_DataInd_t ind;
+
+    ind.data = frame->data;
+    ind.size = frame->size;
+    ind.lqi  = frame->lqi;
+    ind.rssi = frame->rssi;
+    ind.timestamp = frame->timestamp;
+    PHY_DataInd(&ind);
+
+    phyRxQueueTail++;
+  }
+#else
   if (IRQ_STATUS_REG_s.rxEnd)
   {
     PHY_DataInd_t ind;
     uint8_t size = TST_RX_LENGTH_REG;
 
-    for (uint8_t i = 0; i < size + 1/*lqi*/; i++)
-      phyRxBuffer[i] = TRX_FRAME_BUFFER(i);
-
-    ind.data = phyRxBuffer;
-    ind.size = size - PHY_CRC_SIZE;
-    ind.lqi  = phyRxBuffer[size];
-    ind.rssi = (int8_t)PHY_ED_LEVEL_REG + PHY_RSSI_BASE_VAL;
-    PHY_DataInd(&ind);
+    if (size < PHY_MIN_FRAME_SIZE)
+    {
+      phyRxErrors++;
+    }
+    else
+    {
+      // The frame buffer is memory mapped and stays protected by the RX safe
+      // mode until it is released below, so the upper layer can inspect the
+      // frame in place and copy out only what it actually accepts
+      ind.data = (uint8_t *)&TRX_FRAME_BUFFER(0);
+      ind.size = size - PHY_CRC_SIZE;
+      ind.lqi  = TRX_FRAME_BUFFER(size);
+      ind.rssi = (int8_t)PHY_ED_LEVEL_REG + PHY_RSSI_BASE_VAL;
+      PHY_DataInd(&ind);
+    }
 
-    while (TRX_STATUS_RX_AACK_ON != TRX_STATUS_REG_s.trxStatus);
+    // The transceiver may still be sending the acknowledgement
+    phyRxAckPending = true;
 
     IRQ_STATUS_REG_s.rxEnd = 1;
     TRX_CTRL_2_REG_s.rxSafeMode = 0;
     TRX_CTRL_2_REG_s.rxSafeMode = 1;
   }
+#endif
+
+  if (PHY_STATE_TX_WAIT_ON == phyState)
+  {
+    if (phyTrxStep(TRX_STATUS_TX_ARET_ON))
+      phyTxStart();
+  }
+
+  else if (PHY_STATE_IDLE == phyState)
+  {
+    phySetRxState();
+  }
 
-  else if (IRQ_STATUS_REG_s.txEnd)
+  else if (PHY_STATE_TX_WAIT_END == phyState && IRQ_STATUS_REG_s.txEnd)
   {
     if (TRX_STATUS_TX_ARET_ON == TRX_STATUS_REG_s.trxStatus)
     {
@@ -338,8 +652,9 @@ void PHY_TaskHandler(void)
       else
         status = PHY_STATUS_ERROR;
 
-      phySetRxState();
+      IRQ_STATUS_REG = IRQ_CLEAR_VALUE;
       phyState = PHY_STATE_IDLE;
+      phySetRxState();
 
       PHY_DataConf(status);
     }
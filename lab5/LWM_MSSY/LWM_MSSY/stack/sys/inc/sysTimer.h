@@ -76,5 +76,6 @@ void SYS_TimerStart(SYS_Timer_t *timer);
 void SYS_TimerStop(SYS_Timer_t *timer);
 bool SYS_TimerStarted(SYS_Timer_t *timer);
 void SYS_TimerTaskHandler(void);
+uint32_t SYS_TimerGetTime(void);
 
 #endif // _SYS_TIMER_H_
@@ -46,6 +46,7 @@
 
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include "sysEncrypt.h"
 #include "sysConfig.h"
@@ -76,22 +77,56 @@ static void xtea(uint32_t text[2], uint32_t const key[4])
 }
 #endif
 
+#if SYS_SECURITY_MODE == 0
 /*************************************************************************//**
+  @brief Encrypts or decrypts @a size bytes of @a text in CFB mode starting
+         from the 16 byte @a vector, SYS_EncryptConf() is called once the
+         whole text is processed and the @a vector holds the last block
 *****************************************************************************/
-void SYS_EncryptReq(uint8_t *text, uint8_t *key)
+void SYS_EncryptReq(uint8_t *vector, uint8_t *text, uint8_t size, uint8_t *key,
+    bool encrypt)
 {
-#if SYS_SECURITY_MODE == 0
-  PHY_EncryptReq(text, key);
+  PHY_EncryptFrameReq(vector, text, size, key, encrypt);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void PHY_EncryptFrameConf(void)
+{
+  SYS_EncryptConf();
+}
 
 #elif SYS_SECURITY_MODE == 1
-  xtea(&text[0], key);
-  text[2] ^= text[0];
-  text[3] ^= text[1];
-  xtea(&text[2], key);
+/*************************************************************************//**
+*****************************************************************************/
+void SYS_EncryptReq(uint8_t *vector, uint8_t *text, uint8_t size, uint8_t *key,
+    bool encrypt)
+{
+  do
+  {
+    uint8_t block = (size < 16) ? size : 16;
 
-#endif
+    xtea((uint32_t *)&vector[0], (uint32_t *)key);
+    vector[2] ^= vector[0];
+    vector[3] ^= vector[1];
+    xtea((uint32_t *)&vector[2], (uint32_t *)key);
+
+    for (uint8_t i = 0; i < block; i++)
+    {
+      text[i] ^= vector[i];
+
+      if (encrypt)
+        vector[i] = text[i];
+      else
+        vector[i] ^= text[i];
+    }
+
+    text += block;
+    size -= block;
+  } while (size > 0);
 
   SYS_EncryptConf();
 }
+#endif
 
 #endif // NWK_ENABLE_SECURITY
@@ -82,4 +82,8 @@
 #define NWK_ENABLE_ROUTING
 //#define NWK_ENABLE_SECURITY
 
+// The RX queue frees the transceiver while the main loop is busy, but costs
+// a second copy of every frame and PHY_RX_QUEUE_SIZE frames of RAM
+//#define PHY_ENABLE_RX_QUEUE
+
 #endif // _CONFIG_H_
@@ -39,6 +39,12 @@ uint8_t APP_ADDR = 0;
 // Nonce header size - for synchronization
 #define NONCE_HEADER_SIZE   8       // Size of nonce header in transmitted messages
 
+// Received messages waiting for decryption, each one holds an NWK buffer,
+// so the queue can take every frame the NWK layer is able to receive
+#define APP_RX_QUEUE_SIZE   NWK_BUFFERS_RX_QUOTA
+#define APP_RX_PRINT_CHUNK  16      // Characters printed per task handler pass
+#define APP_RETRY_INTERVAL  50      // ms, send retry when no NWK buffer is free
+
 static const uint8_t FIXED_ENCRYPTION_KEY[PSK_LENGTH] = {
     0xA7, 0xF1, 0xD9, 0x2A, 0x82, 0xC8, 0xD8, 0xFE,
     0x43, 0x4D, 0x98, 0x55, 0x8C, 0xE2, 0xB3, 0x47,
@@ -78,16 +84,20 @@ static void print_char_array(const char *str);
 static void prompt_mode_selection(void);
 static void handle_mode_selection(uint8_t byte);
 static void display_mode_status(void);
+static void appRxTaskHandler(void);
 
 /*- Variables --------------------------------------------------------------*/
 static AppState_t appState = APP_STATE_INITIAL;
 static SYS_Timer_t appTimer;
 static NWK_DataReq_t appDataReq;
 static bool appDataReqBusy = false;
-static uint8_t appDataReqBuffer[APP_BUFFER_SIZE];
 static uint8_t appUartBuffer[APP_BUFFER_SIZE - NONCE_HEADER_SIZE]; // Reduced size to accommodate nonce in transmission
 static uint8_t appUartBufferPtr = 0;
 static uint8_t appOperatingMode = MODE_UNDEFINED;
+static NWK_DataInd_t appRxQueue[APP_RX_QUEUE_SIZE];
+static uint8_t appRxHead = 0;
+static uint8_t appRxCount = 0;
+static uint8_t appRxPtr = 0;
 
 // Global variables for encryption
 static uint8_t app_encryption_key[PSK_LENGTH];  // 256-bit key (loaded from EEPROM)
@@ -319,8 +329,23 @@ static void appSendData(void)
         return;
     }
 
+    // Set the destination address based on our address
+    appDataReq.dstAddr = (APP_ADDR == 1) ? 0 : 1;
+    
+    appDataReq.dstEndpoint = APP_ENDPOINT;
+    appDataReq.srcEndpoint = APP_ENDPOINT;
+    appDataReq.options = NWK_OPT_ENABLE_SECURITY;
+    appDataReq.confirm = appDataConf;
+
+    // Build the message directly in the outgoing frame, retried from the timer if no buffer is free
+    uint8_t *payload = NWK_DataReqAlloc(&appDataReq);
+    if (NULL == payload) {
+        SYS_TimerStart(&appTimer);
+        return;
+    }
+
     // Copy the current nonce into the message header
-    memcpy(appDataReqBuffer, current_nonce, NONCE_HEADER_SIZE);
+    memcpy(payload, current_nonce, NONCE_HEADER_SIZE);
     
     if (PSK_DEBUG_MODE) {
         print_debug_hex("[ENCRYPT] Current nonce: ", current_nonce, 8);
@@ -331,25 +356,17 @@ static void appSendData(void)
     salsa20_ivsetup(&encrypt_ctx, current_nonce);
     
     // Encrypt the message data
-    salsa20_encrypt_bytes(&encrypt_ctx, appUartBuffer, appDataReqBuffer + NONCE_HEADER_SIZE, appUartBufferPtr);
+    salsa20_encrypt_bytes(&encrypt_ctx, appUartBuffer, payload + NONCE_HEADER_SIZE, appUartBufferPtr);
     
     if (PSK_DEBUG_MODE) {
-        print_debug_hex("[ENCRYPT] Ciphertext: ", appDataReqBuffer + NONCE_HEADER_SIZE, appUartBufferPtr);
+        print_debug_hex("[ENCRYPT] Ciphertext: ", payload + NONCE_HEADER_SIZE, appUartBufferPtr);
     }
     
     // Increment the nonce for next message
     increment_nonce(current_nonce);
     
-    // Set the destination address based on our address
-    appDataReq.dstAddr = (APP_ADDR == 1) ? 0 : 1;
-    
-    appDataReq.dstEndpoint = APP_ENDPOINT;
-    appDataReq.srcEndpoint = APP_ENDPOINT;
-    appDataReq.options = NWK_OPT_ENABLE_SECURITY;
-    appDataReq.data = appDataReqBuffer;
     appDataReq.size = appUartBufferPtr + NONCE_HEADER_SIZE; // Add nonce size to total size
-    appDataReq.confirm = appDataConf;
-    NWK_DataReq(&appDataReq);
+    NWK_DataReqCommit(&appDataReq);
 
     appUartBufferPtr = 0;
     appDataReqBusy = true;
@@ -434,11 +451,24 @@ static bool appDataInd(NWK_DataInd_t *ind)
         return false;
     }
     
-    uint8_t message_nonce[8];
-    memcpy(message_nonce, ind->data, NONCE_HEADER_SIZE);
+    // Only reachable with aggregated frames, which hold several messages in
+    // one buffer. Messages are sent without acknowledgement, so it is lost.
+    if (appRxCount == APP_RX_QUEUE_SIZE) {
+        print_char_array("\r\n[WARN] Receive queue full - message dropped\r\n");
+        return false;
+    }
+    
+    // Keep the frame buffer, the message is decrypted in place from appRxTaskHandler()
+    appRxQueue[(appRxHead + appRxCount) % APP_RX_QUEUE_SIZE] = *ind;
+    appRxCount++;
+    NWK_DataIndDefer(ind);
     
-    uint8_t decrypted_data[APP_BUFFER_SIZE];
-    memset(decrypted_data, 0, APP_BUFFER_SIZE); // Clear buffer before decryption
+    return true;
+}
+
+static void appRxDecrypt(NWK_DataInd_t *ind)
+{
+    uint8_t *message_nonce = ind->data;
     
     if (PSK_DEBUG_MODE) {
         print_debug_hex("[DECRYPT] Received message with nonce: ", message_nonce, 8);
@@ -449,33 +479,23 @@ static bool appDataInd(NWK_DataInd_t *ind)
     salsa20_keysetup(&decrypt_ctx, app_encryption_key, 256);
     salsa20_ivsetup(&decrypt_ctx, message_nonce);
     
+    // Decrypt in place, the ciphertext is not needed afterwards
     salsa20_encrypt_bytes(&decrypt_ctx,
                           ind->data + NONCE_HEADER_SIZE,
-                          decrypted_data,
+                          ind->data + NONCE_HEADER_SIZE,
                           ind->size - NONCE_HEADER_SIZE);
     
     if (PSK_DEBUG_MODE) {
-      //  print_debug_hex("[DECRYPT] Decrypted plaintext: ", decrypted_data, ind->size - NONCE_HEADER_SIZE);
+      //  print_debug_hex("[DECRYPT] Decrypted plaintext: ", ind->data + NONCE_HEADER_SIZE, ind->size - NONCE_HEADER_SIZE);
     }
 
-    // Ensure the decrypted data is null-terminated
-    decrypted_data[ind->size - NONCE_HEADER_SIZE] = '\0';
-
     print_char_array("\r\n[MESSAGE RECEIVED] ");
-    
-    // Output each byte as a printable character
-    for (uint8_t i = 0; i < ind->size - NONCE_HEADER_SIZE; i++) {
-        // Only print displayable ASCII characters
-        if (decrypted_data[i] >= 32 && decrypted_data[i] <= 126) {
-            HAL_UartWriteByte(decrypted_data[i]);
-        } else {
-            // For non-displayable characters, print a placeholder
-            HAL_UartWriteByte('.');
-        }
-        // Ensure each character is transmitted
-        HAL_UartTaskHandler();
-    }
-    
+}
+
+static void appRxFinish(NWK_DataInd_t *ind)
+{
+    uint8_t *message_nonce = ind->data;
+
     print_char_array("\r\n");
 
     // Update nonce if needed
@@ -503,8 +523,45 @@ static bool appDataInd(NWK_DataInd_t *ind)
     } else if (appOperatingMode == MODE_LISTENER) {
         print_char_array("\r\nListening for messages... (Press 'M' to change mode)\r\n");
     }
+}
+
+static void appRxTaskHandler(void)
+{
+    if (appRxCount == 0) {
+        return;
+    }
     
-    return true;
+    NWK_DataInd_t *ind = &appRxQueue[appRxHead];
+    uint8_t *text = ind->data + NONCE_HEADER_SIZE;
+    uint8_t size = ind->size - NONCE_HEADER_SIZE;
+    
+    if (appRxPtr == 0) {
+        appRxDecrypt(ind);
+    }
+    
+    // Output a few bytes per pass so the network keeps running while printing
+    for (uint8_t i = 0; i < APP_RX_PRINT_CHUNK && appRxPtr < size; i++, appRxPtr++) {
+        // Only print displayable ASCII characters
+        if (text[appRxPtr] >= 32 && text[appRxPtr] <= 126) {
+            HAL_UartWriteByte(text[appRxPtr]);
+        } else {
+            // For non-displayable characters, print a placeholder
+            HAL_UartWriteByte('.');
+        }
+        // Ensure each character is transmitted
+        HAL_UartTaskHandler();
+    }
+    
+    if (appRxPtr < size) {
+        return;
+    }
+    
+    appRxFinish(ind);
+    NWK_DataIndRelease(ind);
+    
+    appRxHead = (appRxHead + 1) % APP_RX_QUEUE_SIZE;
+    appRxCount--;
+    appRxPtr = 0;
 }
 static void appInit(void)
 {
@@ -528,7 +585,7 @@ static void appInit(void)
     NWK_OpenEndpoint(APP_ENDPOINT, appDataInd);
     
     // Set up timer
-    appTimer.interval = 5000;
+    appTimer.interval = APP_RETRY_INTERVAL;
     appTimer.mode = SYS_TIMER_INTERVAL_MODE;
     appTimer.handler = appTimerHandler;
     
@@ -788,5 +845,6 @@ int main(void)
         SYS_TaskHandler();
         HAL_UartTaskHandler();
         APP_TaskHandler();
+        appRxTaskHandler();
     }
 }
\ No newline at end of file
@@ -49,9 +49,12 @@
 
 /*- Includes ---------------------------------------------------------------*/
 #include "sysTypes.h"
+#include "sysConfig.h"
 
 /*- Definitions ------------------------------------------------------------*/
+#ifndef HAL_TIMER_INTERVAL
 #define HAL_TIMER_INTERVAL      10ul // ms
+#endif
 
 /*- Variables --------------------------------------------------------------*/
 extern volatile uint8_t halTimerIrqCount;
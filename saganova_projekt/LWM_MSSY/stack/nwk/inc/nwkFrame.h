@@ -49,10 +49,14 @@
 
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "sysTypes.h"
 
 /*- Definitions ------------------------------------------------------------*/
 #define NWK_FRAME_MAX_PAYLOAD_SIZE   127
+#define NWK_FRAME_COMMAND_SIZE(command) \
+    (sizeof(NwkFrameHeader_t) + sizeof(command) + 4/*NWK_SECURITY_MIC_SIZE*/)
 
 /*- Types ------------------------------------------------------------------*/
 typedef struct PACK NwkFrameHeader_t
@@ -69,7 +73,9 @@ typedef struct PACK NwkFrameHeader_t
     uint8_t   security   : 1;
     uint8_t   linkLocal  : 1;
     uint8_t   multicast  : 1;
-    uint8_t   reserved   : 4;
+    uint8_t   aggregate  : 1;
+    uint8_t   attempt    : 2;
+    uint8_t   reserved   : 1;
   }           nwkFcf;
   uint8_t     nwkSeq;
   uint16_t    nwkSrcAddr;
@@ -89,17 +95,19 @@ typedef struct PACK NwkFrameMulticastHeader_t
   uint16_t    maxMemberRadius    : 4;
 } NwkFrameMulticastHeader_t;
 
+typedef struct PACK NwkFrameAggregateHeader_t
+{
+  uint8_t     srcEndpoint : 4;
+  uint8_t     dstEndpoint : 4;
+  uint8_t     size;
+} NwkFrameAggregateHeader_t;
+
 typedef struct NwkFrame_t
 {
+  struct NwkFrame_t *next;
   uint8_t      state;
   uint8_t      size;
-
-  union
-  {
-    NwkFrameHeader_t header;
-    uint8_t          data[NWK_FRAME_MAX_PAYLOAD_SIZE];
-  };
-
+  uint8_t      bufferClass;
   uint8_t      *payload;
 
   union
@@ -108,25 +116,56 @@ typedef struct NwkFrame_t
     {
       uint8_t  lqi;
       int8_t   rssi;
+      uint8_t  deferred;
+    #ifdef NWK_ENABLE_SECURITY
+      uint8_t  ackOnly;  // acknowledged retransmission, re-ACK once verified
+    #endif
     } rx;
 
     struct
     {
       uint8_t  status;
-      uint16_t timeout;
+      uint32_t timeout;
       uint8_t  control;
+      uint8_t  priority;
+    #ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+      uint16_t sentTime;
+    #endif
+    #ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+      uint8_t  copies;
+    #endif
       void     (*confirm)(struct NwkFrame_t *frame);
     } tx;
   };
+
+  // Must be the last field, small buffers are allocated without the tail
+  union
+  {
+    NwkFrameHeader_t header;
+    uint8_t          data[NWK_FRAME_MAX_PAYLOAD_SIZE];
+  };
 } NwkFrame_t;
 
+typedef struct NwkFrameQueue_t
+{
+  NwkFrame_t   *head;
+  NwkFrame_t   *tail;
+} NwkFrameQueue_t;
+
 /*- Prototypes -------------------------------------------------------------*/
 void nwkFrameInit(void);
-NwkFrame_t *nwkFrameAlloc(void);
+bool nwkFrameAvailable(uint8_t bufferClass, uint8_t size);
+uint8_t nwkFrameClassUsed(uint8_t bufferClass);
+NwkFrame_t *nwkFrameAlloc(uint8_t bufferClass, uint8_t size);
 void nwkFrameFree(NwkFrame_t *frame);
 NwkFrame_t *nwkFrameNext(NwkFrame_t *frame);
 void nwkFrameCommandInit(NwkFrame_t *frame);
 
+void nwkFrameQueueInit(NwkFrameQueue_t *queue);
+void nwkFrameQueuePush(NwkFrameQueue_t *queue, NwkFrame_t *frame);
+NwkFrame_t *nwkFrameQueuePop(NwkFrameQueue_t *queue);
+void nwkFrameQueueRemove(NwkFrameQueue_t *queue, NwkFrame_t *frame);
+
 /*- Implementations --------------------------------------------------------*/
 
 /*************************************************************************//**
@@ -136,4 +175,11 @@ static inline uint8_t nwkFramePayloadSize(NwkFrame_t *frame)
   return frame->size - (frame->payload - frame->data);
 }
 
+/*************************************************************************//**
+*****************************************************************************/
+static inline bool nwkFrameQueueEmpty(NwkFrameQueue_t *queue)
+{
+  return NULL == queue->head;
+}
+
 #endif // _NWK_FRAME_H_
@@ -70,6 +70,10 @@ typedef struct NWK_RouteTableEntry_t
   uint16_t nextHopAddr;
   uint8_t  rank;
   uint8_t  lqi;
+#ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+  uint16_t srtt;   // ms * 8, 0 if not measured yet
+  uint16_t rttvar; // ms * 4
+#endif
 } NWK_RouteTableEntry_t;
 
 /*- Prototypes -------------------------------------------------------------*/
@@ -87,6 +91,11 @@ void nwkRoutePrepareTx(NwkFrame_t *frame);
 void nwkRouteFrame(NwkFrame_t *frame);
 bool nwkRouteErrorReceived(NWK_DataInd_t *ind);
 void nwkRouteUpdateEntry(uint16_t dst, uint8_t multicast, uint16_t nextHop, uint8_t lqi);
+#ifdef NWK_ENABLE_ADAPTIVE_ACK_WAIT
+uint16_t nwkRouteAckWaitTime(uint16_t dst, uint8_t multicast);
+void nwkRouteAckReceived(uint16_t dst, uint8_t multicast, uint16_t rtt);
+void nwkRouteAckTimeout(uint16_t dst, uint8_t multicast);
+#endif
 
 #endif // NWK_ENABLE_ROUTING
 
@@ -65,7 +65,13 @@ enum
 void nwkTxInit(void);
 void nwkTxFrame(NwkFrame_t *frame);
 void nwkTxBroadcastFrame(NwkFrame_t *frame);
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+void nwkTxBroadcastCopyReceived(NwkFrameHeader_t *header);
+#endif
 bool nwkTxAckReceived(NWK_DataInd_t *ind);
+#ifdef NWK_ENABLE_BLOCK_ACK
+bool nwkTxBlockAckReceived(NWK_DataInd_t *ind);
+#endif
 void nwkTxConfirm(NwkFrame_t *frame, uint8_t status);
 void nwkTxEncryptConf(NwkFrame_t *frame);
 void nwkTxTaskHandler(void);
@@ -0,0 +1,727 @@
+/**
+ * \file nwkFrag.c
+ *
+ * \brief NWK_FragReq() implementation
+ *
+ * Copyright (C) 2012-2014, Atmel Corporation. All rights reserved.
+ *
+ * \asf_license_start
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. The name of Atmel may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. This software may only be redistributed and used in connection with an
+ *    Atmel microcontroller product.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * EXPRESSLY AND SPECIFICALLY DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \asf_license_stop
+ *
+ * Modification and other use of this code is subject to Atmel's Limited
+ * License Agreement (license.txt).
+ *
+ * $Id$
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sysConfig.h"
+#include "sysTimer.h"
+#include "nwk.h"
+#include "nwkFrag.h"
+
+#ifdef NWK_ENABLE_FRAGMENTATION
+
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_FRAG_RX_TIMER_INTERVAL     100 // ms
+#define NWK_FRAG_MASK_SIZE             ((NWK_FRAG_MAX_FRAGMENTS + 7) / 8)
+#define NWK_FRAG_FRAGMENT_SIZE \
+    ((uint8_t)(NWK_MAX_PAYLOAD_SIZE - NWK_SECURITY_MIC_SIZE - sizeof(NwkFragHeader_t)))
+
+/*- Types ------------------------------------------------------------------*/
+enum
+{
+  NWK_FRAG_TYPE_DATA          = 0x00,
+  NWK_FRAG_TYPE_ACK           = 0x01,
+  NWK_FRAG_TYPE_REJECT        = 0x02,
+};
+
+enum
+{
+  NWK_FRAG_FLAG_ACK_REQUEST   = 1 << 0,
+};
+
+enum
+{
+  NWK_FRAG_REQ_STATE_INITIAL,
+  NWK_FRAG_REQ_STATE_SEND,
+  NWK_FRAG_REQ_STATE_WAIT_CONF,
+  NWK_FRAG_REQ_STATE_WAIT_ACK,
+  NWK_FRAG_REQ_STATE_CONFIRM,
+};
+
+enum
+{
+  NWK_FRAG_RX_STATE_FREE,
+  NWK_FRAG_RX_STATE_ACTIVE,
+  NWK_FRAG_RX_STATE_DONE,
+};
+
+typedef struct PACK NwkFragHeader_t
+{
+  uint8_t    type;
+  uint8_t    tag;
+  uint8_t    flags;
+  uint8_t    index;
+  uint8_t    count;
+  uint8_t    fragmentSize;
+  uint16_t   size;
+  uint8_t    srcEndpoint : 4;
+  uint8_t    dstEndpoint : 4;
+} NwkFragHeader_t;
+
+typedef struct PACK NwkFragAck_t
+{
+  uint8_t    type;
+  uint8_t    tag;
+  uint8_t    mask[NWK_FRAG_MASK_SIZE];
+} NwkFragAck_t;
+
+typedef struct NwkFragRxBuffer_t
+{
+  uint8_t    state;
+  uint16_t   srcAddr;
+  uint8_t    tag;
+  uint8_t    srcEndpoint;
+  uint8_t    dstEndpoint;
+  uint8_t    count;
+  uint8_t    missing;
+  uint16_t   size;
+  uint16_t   timeout;
+  uint8_t    mask[NWK_FRAG_MASK_SIZE];
+  uint8_t    data[NWK_FRAG_RX_BUFFER_SIZE];
+} NwkFragRxBuffer_t;
+
+/*- Prototypes -------------------------------------------------------------*/
+static bool nwkFragDataInd(NWK_DataInd_t *ind);
+static void nwkFragDataConf(NWK_DataReq_t *req);
+static void nwkFragAckConf(NWK_DataReq_t *req);
+static void nwkFragAckTimerHandler(SYS_Timer_t *timer);
+static void nwkFragRxTimerHandler(SYS_Timer_t *timer);
+static void nwkFragAckDelayTimerHandler(SYS_Timer_t *timer);
+
+/*- Variables --------------------------------------------------------------*/
+static NWK_FragReq_t *nwkFragReqQueue;
+static uint8_t nwkFragTag;
+
+static NWK_DataReq_t nwkFragTxDataReq[NWK_FRAG_WINDOW];
+static uint8_t nwkFragTxAcked[NWK_FRAG_MASK_SIZE];
+static uint8_t nwkFragTxCount;
+static uint8_t nwkFragTxNext;
+static uint8_t nwkFragTxLeft;
+static uint8_t nwkFragTxPending;
+static uint8_t nwkFragTxRetries;
+static bool nwkFragTxAckReceived;
+static SYS_Timer_t nwkFragAckTimer;
+
+static NwkFragRxBuffer_t nwkFragRxBuffers[NWK_FRAG_RX_BUFFERS_AMOUNT];
+static NWK_DataReq_t nwkFragAckReq;
+static NwkFragAck_t nwkFragAckData;
+static bool nwkFragAckBusy;
+static NwkFragRxBuffer_t *nwkFragAckBuffer;
+static uint8_t nwkFragAckOptions;
+static SYS_Timer_t nwkFragAckDelayTimer;
+static SYS_Timer_t nwkFragRxTimer;
+static void (*nwkFragEndpoint[NWK_ENDPOINTS_AMOUNT])(NWK_FragInd_t *ind);
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Initializes the Fragmentation module
+*****************************************************************************/
+void nwkFragInit(void)
+{
+  nwkFragReqQueue = NULL;
+  nwkFragTag = 0;
+  nwkFragAckBusy = false;
+  nwkFragAckBuffer = NULL;
+
+  for (uint8_t i = 0; i < NWK_FRAG_RX_BUFFERS_AMOUNT; i++)
+    nwkFragRxBuffers[i].state = NWK_FRAG_RX_STATE_FREE;
+
+  for (uint8_t i = 0; i < NWK_ENDPOINTS_AMOUNT; i++)
+    nwkFragEndpoint[i] = NULL;
+
+  nwkFragAckTimer.interval = NWK_FRAG_ACK_TIMEOUT;
+  nwkFragAckTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkFragAckTimer.handler = nwkFragAckTimerHandler;
+
+  nwkFragAckDelayTimer.interval = NWK_FRAG_ACK_DELAY;
+  nwkFragAckDelayTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkFragAckDelayTimer.handler = nwkFragAckDelayTimerHandler;
+
+  nwkFragRxTimer.interval = NWK_FRAG_RX_TIMER_INTERVAL;
+  nwkFragRxTimer.mode = SYS_TIMER_INTERVAL_MODE;
+  nwkFragRxTimer.handler = nwkFragRxTimerHandler;
+
+  NWK_OpenEndpoint(NWK_FRAG_ENDPOINT, nwkFragDataInd);
+}
+
+/*************************************************************************//**
+  @brief Registers callback @a handler for reassembled messages sent to the
+         endpoint @a id
+  @param[in] id Endpoint index (1-15)
+  @param[in] handler Pointer to the callback function
+*****************************************************************************/
+void NWK_FragOpenEndpoint(uint8_t id, void (*handler)(NWK_FragInd_t *ind))
+{
+  nwkFragEndpoint[id] = handler;
+}
+
+/*************************************************************************//**
+  @brief Adds request @a req to the queue of outgoing fragmented transfers,
+         transfers are sent one at a time in the order they were requested
+  @param[in] req Pointer to the request parameters
+*****************************************************************************/
+void NWK_FragReq(NWK_FragReq_t *req)
+{
+  req->state = NWK_FRAG_REQ_STATE_INITIAL;
+  req->status = NWK_SUCCESS_STATUS;
+  req->startTime = SYS_TimerGetTime();
+  req->sent = 0;
+  req->time = 0;
+  req->next = NULL;
+
+  nwkIb.lock++;
+
+  if (NULL == nwkFragReqQueue)
+  {
+    nwkFragReqQueue = req;
+  }
+  else
+  {
+    NWK_FragReq_t *last = nwkFragReqQueue;
+
+    while (last->next)
+      last = last->next;
+    last->next = req;
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static inline bool nwkFragMaskGet(uint8_t *mask, uint8_t index)
+{
+  return mask[index / 8] & (1 << (index % 8));
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static inline void nwkFragMaskSet(uint8_t *mask, uint8_t index)
+{
+  mask[index / 8] |= (1 << (index % 8));
+}
+
+/*************************************************************************//**
+  @brief Starts a new round of up to NWK_FRAG_WINDOW unacknowledged fragments
+         or finishes the transfer if there are none left
+  @param[in] req Pointer to the active request
+*****************************************************************************/
+static void nwkFragStartRound(NWK_FragReq_t *req)
+{
+  uint8_t missing = 0;
+
+  for (uint8_t i = 0; i < nwkFragTxCount; i++)
+  {
+    if (!nwkFragMaskGet(nwkFragTxAcked, i))
+      missing++;
+  }
+
+  if (NWK_SUCCESS_STATUS != req->status || 0 == missing)
+  {
+    req->state = NWK_FRAG_REQ_STATE_CONFIRM;
+    return;
+  }
+
+  nwkFragTxNext = 0;
+  nwkFragTxLeft = (missing < NWK_FRAG_WINDOW) ? missing : NWK_FRAG_WINDOW;
+  nwkFragTxAckReceived = false;
+  req->state = NWK_FRAG_REQ_STATE_SEND;
+}
+
+/*************************************************************************//**
+  @brief Starts transmission of the request @a req
+  @param[in] req Pointer to the request parameters
+*****************************************************************************/
+static void nwkFragStart(NWK_FragReq_t *req)
+{
+  uint16_t count = (req->size + NWK_FRAG_FRAGMENT_SIZE - 1) / NWK_FRAG_FRAGMENT_SIZE;
+
+  if (0 == count || count > NWK_FRAG_MAX_FRAGMENTS)
+  {
+    req->status = NWK_ERROR_STATUS;
+    req->state = NWK_FRAG_REQ_STATE_CONFIRM;
+    return;
+  }
+
+  req->tag = ++nwkFragTag;
+
+  nwkFragTxCount = count;
+  nwkFragTxRetries = 0;
+  nwkFragTxPending = 0;
+  memset(nwkFragTxAcked, 0, sizeof(nwkFragTxAcked));
+
+  nwkFragStartRound(req);
+}
+
+/*************************************************************************//**
+  @brief Handles the end of a round, once all its fragments are confirmed
+         the sender waits for the acknowledgement from the receiver
+  @param[in] req Pointer to the active request
+*****************************************************************************/
+static void nwkFragRoundSent(NWK_FragReq_t *req)
+{
+  if (nwkFragTxAckReceived)
+  {
+    nwkFragStartRound(req);
+  }
+  else
+  {
+    req->state = NWK_FRAG_REQ_STATE_WAIT_ACK;
+    SYS_TimerStart(&nwkFragAckTimer);
+  }
+}
+
+/*************************************************************************//**
+  @brief Sends the remaining fragments of the current round, the frames are
+         built in place with NWK_DataReqAlloc()
+  @param[in] req Pointer to the active request
+*****************************************************************************/
+static void nwkFragSendFragments(NWK_FragReq_t *req)
+{
+  while (nwkFragTxLeft)
+  {
+    NWK_DataReq_t *dataReq = &nwkFragTxDataReq[NWK_FRAG_WINDOW - nwkFragTxLeft];
+    NwkFragHeader_t *header;
+    uint16_t offset;
+    uint8_t size;
+
+    while (nwkFragTxNext < nwkFragTxCount && nwkFragMaskGet(nwkFragTxAcked, nwkFragTxNext))
+      nwkFragTxNext++;
+
+    // Every fragment is already acknowledged
+    if (nwkFragTxNext >= nwkFragTxCount)
+    {
+      nwkFragTxLeft = 0;
+      break;
+    }
+
+    dataReq->dstAddr = req->dstAddr;
+    dataReq->dstEndpoint = NWK_FRAG_ENDPOINT;
+    dataReq->srcEndpoint = NWK_FRAG_ENDPOINT;
+    dataReq->options = req->options & (NWK_OPT_ENABLE_SECURITY | NWK_OPT_LINK_LOCAL);
+    dataReq->priority = NWK_PRIORITY_DATA;
+    dataReq->confirm = nwkFragDataConf;
+
+    // Retried on the next pass of the task handler
+    if (NULL == (header = (NwkFragHeader_t *)NWK_DataReqAlloc(dataReq)))
+      return;
+
+    offset = nwkFragTxNext * NWK_FRAG_FRAGMENT_SIZE;
+    size = (req->size - offset < NWK_FRAG_FRAGMENT_SIZE) ? req->size - offset : NWK_FRAG_FRAGMENT_SIZE;
+
+    header->type = NWK_FRAG_TYPE_DATA;
+    header->tag = req->tag;
+    header->flags = (1 == nwkFragTxLeft) ? NWK_FRAG_FLAG_ACK_REQUEST : 0;
+    header->index = nwkFragTxNext;
+    header->count = nwkFragTxCount;
+    header->fragmentSize = NWK_FRAG_FRAGMENT_SIZE;
+    header->size = req->size;
+    header->srcEndpoint = req->srcEndpoint;
+    header->dstEndpoint = req->dstEndpoint;
+    memcpy((uint8_t *)header + sizeof(NwkFragHeader_t), req->data + offset, size);
+
+    dataReq->size = sizeof(NwkFragHeader_t) + size;
+    NWK_DataReqCommit(dataReq);
+
+    nwkFragTxNext++;
+    nwkFragTxLeft--;
+    nwkFragTxPending++;
+    req->sent++;
+  }
+
+  req->state = NWK_FRAG_REQ_STATE_WAIT_CONF;
+
+  if (0 == nwkFragTxPending)
+    nwkFragRoundSent(req);
+}
+
+/*************************************************************************//**
+  @brief Fragment transmission confirmation handler, delivery is tracked by
+         the receiver acknowledgements, so the status is not checked here
+  @param[in] dataReq Pointer to the fragment request
+*****************************************************************************/
+static void nwkFragDataConf(NWK_DataReq_t *dataReq)
+{
+  NWK_FragReq_t *req = nwkFragReqQueue;
+
+  nwkFragTxPending--;
+
+  if (0 == nwkFragTxPending && NWK_FRAG_REQ_STATE_WAIT_CONF == req->state)
+    nwkFragRoundSent(req);
+
+  (void)dataReq;
+}
+
+/*************************************************************************//**
+  @brief Acknowledgement wait timer handler, the unacknowledged fragments are
+         sent again until NWK_FRAG_MAX_RETRIES rounds pass without progress
+  @param[in] timer Pointer to the timer
+*****************************************************************************/
+static void nwkFragAckTimerHandler(SYS_Timer_t *timer)
+{
+  NWK_FragReq_t *req = nwkFragReqQueue;
+
+  if (NULL == req || NWK_FRAG_REQ_STATE_WAIT_ACK != req->state)
+    return;
+
+  if (++nwkFragTxRetries > NWK_FRAG_MAX_RETRIES)
+  {
+    req->status = NWK_NO_ACK_STATUS;
+    req->state = NWK_FRAG_REQ_STATE_CONFIRM;
+  }
+  else
+  {
+    nwkFragStartRound(req);
+  }
+
+  (void)timer;
+}
+
+/*************************************************************************//**
+  @brief Handles an acknowledgement or a reject from the receiver
+  @param[in] ind Pointer to the indication
+*****************************************************************************/
+static void nwkFragAckReceived(NWK_DataInd_t *ind)
+{
+  NwkFragAck_t *ack = (NwkFragAck_t *)ind->data;
+  NWK_FragReq_t *req = nwkFragReqQueue;
+
+  if (NULL == req || NWK_FRAG_REQ_STATE_INITIAL == req->state ||
+      NWK_FRAG_REQ_STATE_CONFIRM == req->state ||
+      req->tag != ack->tag || req->dstAddr != ind->srcAddr)
+    return;
+
+  if (NWK_FRAG_TYPE_REJECT == ack->type)
+  {
+    req->status = NWK_ERROR_STATUS;
+  }
+  else
+  {
+    if (ind->size < sizeof(NwkFragAck_t))
+      return;
+
+    for (uint8_t i = 0; i < NWK_FRAG_MASK_SIZE; i++)
+    {
+      if (ack->mask[i] & ~nwkFragTxAcked[i])
+        nwkFragTxRetries = 0;
+      nwkFragTxAcked[i] |= ack->mask[i];
+    }
+  }
+
+  if (NWK_FRAG_REQ_STATE_WAIT_ACK == req->state)
+  {
+    SYS_TimerStop(&nwkFragAckTimer);
+    nwkFragStartRound(req);
+  }
+  else
+  {
+    nwkFragTxAckReceived = true;
+  }
+}
+
+/*************************************************************************//**
+  @brief Sends an acknowledgement with the reception @a mask of the transfer
+         @a tag to the node @a dst
+  @return @c false if the previous acknowledgement is still pending
+*****************************************************************************/
+static bool nwkFragSendAck(uint16_t dst, uint8_t options, uint8_t tag, uint8_t type, uint8_t *mask)
+{
+  if (nwkFragAckBusy)
+    return false;
+
+  nwkFragAckData.type = type;
+  nwkFragAckData.tag = tag;
+
+  if (mask)
+    memcpy(nwkFragAckData.mask, mask, NWK_FRAG_MASK_SIZE);
+  else
+    memset(nwkFragAckData.mask, 0, NWK_FRAG_MASK_SIZE);
+
+  nwkFragAckReq.dstAddr = dst;
+  nwkFragAckReq.dstEndpoint = NWK_FRAG_ENDPOINT;
+  nwkFragAckReq.srcEndpoint = NWK_FRAG_ENDPOINT;
+  nwkFragAckReq.options = options;
+  nwkFragAckReq.priority = NWK_PRIORITY_ACK;
+  nwkFragAckReq.data = (uint8_t *)&nwkFragAckData;
+  nwkFragAckReq.size = sizeof(NwkFragAck_t);
+  nwkFragAckReq.confirm = nwkFragAckConf;
+  NWK_DataReq(&nwkFragAckReq);
+
+  nwkFragAckBusy = true;
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Schedules an acknowledgement for the reassembly buffer @a buffer,
+         it is delayed for NWK_FRAG_ACK_DELAY, so that fragments of the round
+         received out of order are reported as well
+*****************************************************************************/
+static void nwkFragScheduleAck(NwkFragRxBuffer_t *buffer, NWK_DataInd_t *ind)
+{
+  if (nwkFragAckBuffer)
+    return;
+
+  nwkFragAckBuffer = buffer;
+  nwkFragAckOptions = (ind->options & NWK_IND_OPT_SECURED) ? NWK_OPT_ENABLE_SECURITY : 0;
+  SYS_TimerStart(&nwkFragAckDelayTimer);
+}
+
+/*************************************************************************//**
+  @brief Acknowledgement delay timer handler
+  @param[in] timer Pointer to the timer
+*****************************************************************************/
+static void nwkFragAckDelayTimerHandler(SYS_Timer_t *timer)
+{
+  NwkFragRxBuffer_t *buffer = nwkFragAckBuffer;
+
+  if (NWK_FRAG_RX_STATE_FREE != buffer->state &&
+      !nwkFragSendAck(buffer->srcAddr, nwkFragAckOptions, buffer->tag, NWK_FRAG_TYPE_ACK, buffer->mask))
+  {
+    SYS_TimerStart(timer);
+    return;
+  }
+
+  nwkFragAckBuffer = NULL;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkFragAckConf(NWK_DataReq_t *req)
+{
+  nwkFragAckBusy = false;
+  (void)req;
+}
+
+/*************************************************************************//**
+  @brief Finds a reassembly buffer for the transfer @a tag from @a src or
+         takes a new one, free buffers are preferred over completed ones
+*****************************************************************************/
+static NwkFragRxBuffer_t *nwkFragRxFindBuffer(uint16_t src, uint8_t tag, bool alloc)
+{
+  NwkFragRxBuffer_t *done = NULL;
+
+  for (uint8_t i = 0; i < NWK_FRAG_RX_BUFFERS_AMOUNT; i++)
+  {
+    NwkFragRxBuffer_t *buffer = &nwkFragRxBuffers[i];
+
+    if (NWK_FRAG_RX_STATE_FREE != buffer->state && src == buffer->srcAddr && tag == buffer->tag)
+      return buffer;
+  }
+
+  if (!alloc)
+    return NULL;
+
+  for (uint8_t i = 0; i < NWK_FRAG_RX_BUFFERS_AMOUNT; i++)
+  {
+    NwkFragRxBuffer_t *buffer = &nwkFragRxBuffers[i];
+
+    if (NWK_FRAG_RX_STATE_FREE == buffer->state)
+      return buffer;
+
+    if (NWK_FRAG_RX_STATE_DONE == buffer->state)
+      done = buffer;
+  }
+
+  return done;
+}
+
+/*************************************************************************//**
+  @brief Stores a received fragment and indicates the message once all of its
+         fragments are received
+  @param[in] ind Pointer to the indication
+*****************************************************************************/
+static void nwkFragDataReceived(NWK_DataInd_t *ind)
+{
+  NwkFragHeader_t *header = (NwkFragHeader_t *)ind->data;
+  NwkFragRxBuffer_t *buffer;
+  uint16_t offset;
+  uint8_t size;
+
+  if (ind->size < sizeof(NwkFragHeader_t))
+    return;
+
+  size = ind->size - sizeof(NwkFragHeader_t);
+  offset = header->index * header->fragmentSize;
+
+  if (NULL == (buffer = nwkFragRxFindBuffer(ind->srcAddr, header->tag, false)))
+  {
+    if (0 == header->count || header->count > NWK_FRAG_MAX_FRAGMENTS ||
+        header->size > NWK_FRAG_RX_BUFFER_SIZE || NULL == nwkFragEndpoint[header->dstEndpoint])
+    {
+      nwkFragSendAck(ind->srcAddr, (ind->options & NWK_IND_OPT_SECURED) ? NWK_OPT_ENABLE_SECURITY : 0,
+          header->tag, NWK_FRAG_TYPE_REJECT, NULL);
+      return;
+    }
+
+    // All buffers are busy, the sender will retry
+    if (NULL == (buffer = nwkFragRxFindBuffer(ind->srcAddr, header->tag, true)))
+      return;
+
+    buffer->state = NWK_FRAG_RX_STATE_ACTIVE;
+    buffer->srcAddr = ind->srcAddr;
+    buffer->tag = header->tag;
+    buffer->srcEndpoint = header->srcEndpoint;
+    buffer->dstEndpoint = header->dstEndpoint;
+    buffer->count = header->count;
+    buffer->missing = header->count;
+    buffer->size = header->size;
+    memset(buffer->mask, 0, sizeof(buffer->mask));
+  }
+
+  buffer->timeout = NWK_FRAG_REASSEMBLY_TIMEOUT / NWK_FRAG_RX_TIMER_INTERVAL + 1;
+  SYS_TimerStart(&nwkFragRxTimer);
+
+  if (NWK_FRAG_RX_STATE_ACTIVE == buffer->state && header->index < buffer->count &&
+      !nwkFragMaskGet(buffer->mask, header->index) && offset + size <= buffer->size)
+  {
+    memcpy(buffer->data + offset, ind->data + sizeof(NwkFragHeader_t), size);
+    nwkFragMaskSet(buffer->mask, header->index);
+
+    if (0 == --buffer->missing)
+    {
+      NWK_FragInd_t fragInd;
+
+      fragInd.srcAddr = buffer->srcAddr;
+      fragInd.srcEndpoint = buffer->srcEndpoint;
+      fragInd.dstEndpoint = buffer->dstEndpoint;
+      fragInd.data = buffer->data;
+      fragInd.size = buffer->size;
+
+      // The buffer is kept to answer retransmissions of the last fragments
+      buffer->state = NWK_FRAG_RX_STATE_DONE;
+      nwkFragEndpoint[buffer->dstEndpoint](&fragInd);
+
+      nwkFragScheduleAck(buffer, ind);
+      return;
+    }
+  }
+
+  if (header->flags & NWK_FRAG_FLAG_ACK_REQUEST)
+    nwkFragScheduleAck(buffer, ind);
+}
+
+/*************************************************************************//**
+  @brief Releases reassembly buffers that did not receive fragments for
+         NWK_FRAG_REASSEMBLY_TIMEOUT
+  @param[in] timer Pointer to the timer
+*****************************************************************************/
+static void nwkFragRxTimerHandler(SYS_Timer_t *timer)
+{
+  bool restart = false;
+
+  for (uint8_t i = 0; i < NWK_FRAG_RX_BUFFERS_AMOUNT; i++)
+  {
+    NwkFragRxBuffer_t *buffer = &nwkFragRxBuffers[i];
+
+    if (NWK_FRAG_RX_STATE_FREE == buffer->state)
+      continue;
+
+    if (0 == --buffer->timeout)
+      buffer->state = NWK_FRAG_RX_STATE_FREE;
+    else
+      restart = true;
+  }
+
+  if (restart)
+    SYS_TimerStart(timer);
+}
+
+/*************************************************************************//**
+  @brief Fragmentation endpoint handler
+  @param[in] ind Pointer to the indication
+  @return Always @c true, delivery is acknowledged by the fragmentation layer
+*****************************************************************************/
+static bool nwkFragDataInd(NWK_DataInd_t *ind)
+{
+  if (ind->size < 2)
+    return true;
+
+  if (NWK_FRAG_TYPE_DATA == ind->data[0])
+    nwkFragDataReceived(ind);
+  else
+    nwkFragAckReceived(ind);
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Fragmentation module task handler
+*****************************************************************************/
+void nwkFragTaskHandler(void)
+{
+  NWK_FragReq_t *req = nwkFragReqQueue;
+
+  if (NULL == req)
+    return;
+
+  switch (req->state)
+  {
+    case NWK_FRAG_REQ_STATE_INITIAL:
+    {
+      nwkFragStart(req);
+    } break;
+
+    case NWK_FRAG_REQ_STATE_SEND:
+    {
+      nwkFragSendFragments(req);
+    } break;
+
+    case NWK_FRAG_REQ_STATE_CONFIRM:
+    {
+      nwkFragReqQueue = req->next;
+      req->time = SYS_TimerGetTime() - req->startTime;
+      nwkIb.lock--;
+      req->confirm(req);
+    } break;
+
+    default:
+      break;
+  }
+}
+
+#endif // NWK_ENABLE_FRAGMENTATION
@@ -53,6 +53,10 @@
 #include "nwk.h"
 #include "nwkFrame.h"
 
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_FRAME_SMALL_SIZE \
+    ((offsetof(NwkFrame_t, data) + NWK_SMALL_BUFFER_SIZE + sizeof(void *) - 1) / sizeof(void *))
+
 /*- Types ------------------------------------------------------------------*/
 enum
 {
@@ -61,6 +65,22 @@ enum
 
 /*- Variables --------------------------------------------------------------*/
 static NwkFrame_t nwkFrameFrames[NWK_BUFFERS_AMOUNT];
+static NwkFrame_t *nwkFrameFreeList;
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+// Small frames share the NwkFrame_t layout but only have room for
+// NWK_SMALL_BUFFER_SIZE bytes of data, void pointers keep them aligned
+static void *nwkFrameSmallFrames[NWK_SMALL_BUFFERS_AMOUNT][NWK_FRAME_SMALL_SIZE];
+static NwkFrame_t *nwkFrameSmallFreeList;
+#endif
+static uint8_t nwkFrameFreeAmount;
+static uint8_t nwkFrameClassAmount[NWK_BUFFER_CLASSES_AMOUNT];
+static const uint8_t nwkFrameClassQuota[NWK_BUFFER_CLASSES_AMOUNT] =
+{
+  [NWK_BUFFER_CLASS_RX]          = NWK_BUFFERS_RX_QUOTA,
+  [NWK_BUFFER_CLASS_REBROADCAST] = NWK_BUFFERS_REBROADCAST_QUOTA,
+  [NWK_BUFFER_CLASS_DATA]        = NWK_BUFFERS_DATA_QUOTA,
+  [NWK_BUFFER_CLASS_CONTROL]     = NWK_BUFFERS_AMOUNT,
+};
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -69,28 +89,147 @@ static NwkFrame_t nwkFrameFrames[NWK_BUFFERS_AMOUNT];
 *****************************************************************************/
 void nwkFrameInit(void)
 {
-  for (uint8_t i = 0; i < NWK_BUFFERS_AMOUNT; i++)
-    nwkFrameFrames[i].state = NWK_FRAME_STATE_FREE;
+  nwkFrameFreeList = NULL;
+  nwkFrameFreeAmount = NWK_BUFFERS_AMOUNT;
+
+  for (uint8_t i = 0; i < NWK_BUFFER_CLASSES_AMOUNT; i++)
+    nwkFrameClassAmount[i] = 0;
+
+  for (uint8_t i = NWK_BUFFERS_AMOUNT; i > 0; i--)
+  {
+    nwkFrameFrames[i - 1].state = NWK_FRAME_STATE_FREE;
+    nwkFrameFrames[i - 1].next = nwkFrameFreeList;
+    nwkFrameFreeList = &nwkFrameFrames[i - 1];
+  }
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  nwkFrameSmallFreeList = NULL;
+
+  for (uint8_t i = NWK_SMALL_BUFFERS_AMOUNT; i > 0; i--)
+  {
+    NwkFrame_t *frame = (NwkFrame_t *)nwkFrameSmallFrames[i - 1];
+
+    frame->state = NWK_FRAME_STATE_FREE;
+    frame->next = nwkFrameSmallFreeList;
+    nwkFrameSmallFreeList = frame;
+  }
+#endif
+}
+
+/*************************************************************************//**
+  @brief Returns the frame with index @a i, full size frames go first
+*****************************************************************************/
+static inline NwkFrame_t *nwkFrameByIndex(uint8_t i)
+{
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (i >= NWK_BUFFERS_AMOUNT)
+    return (NwkFrame_t *)nwkFrameSmallFrames[i - NWK_BUFFERS_AMOUNT];
+#endif
+  return &nwkFrameFrames[i];
+}
+
+/*************************************************************************//**
+  @brief Returns the index of the @a frame, inverse of nwkFrameByIndex()
+*****************************************************************************/
+static inline uint8_t nwkFrameIndex(NwkFrame_t *frame)
+{
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (frame < nwkFrameFrames || frame >= &nwkFrameFrames[NWK_BUFFERS_AMOUNT])
+    return NWK_BUFFERS_AMOUNT + ((void **)frame - nwkFrameSmallFrames[0]) / NWK_FRAME_SMALL_SIZE;
+#endif
+  return frame - nwkFrameFrames;
+}
+
+/*************************************************************************//**
+  @brief Checks if nwkFrameAlloc() would succeed for the same parameters,
+         the allocation failure statistics are not updated
+  @param[in] bufferClass Traffic class the frame would be allocated for
+  @param[in] size Number of data bytes the frame would hold
+  @return @c true if there is a free frame
+*****************************************************************************/
+bool nwkFrameAvailable(uint8_t bufferClass, uint8_t size)
+{
+  if (nwkFrameClassAmount[bufferClass] >= nwkFrameClassQuota[bufferClass])
+    return false;
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (size <= NWK_SMALL_BUFFER_SIZE && nwkFrameSmallFreeList)
+    return true;
+#else
+  (void)size;
+#endif
+
+  return NULL != nwkFrameFreeList &&
+      (NWK_BUFFER_CLASS_CONTROL == bufferClass || nwkFrameFreeAmount > NWK_BUFFERS_CONTROL_RESERVED);
+}
+
+/*************************************************************************//**
+  @brief Returns the number of frames allocated for the traffic class
+         @a bufferClass
+*****************************************************************************/
+uint8_t nwkFrameClassUsed(uint8_t bufferClass)
+{
+  return nwkFrameClassAmount[bufferClass];
 }
 
 /*************************************************************************//**
   @brief Allocates an empty frame from the buffer pool
+  @param[in] bufferClass Traffic class the frame is allocated for. Each class
+             is limited by its quota and only control frames may use the last
+             NWK_BUFFERS_CONTROL_RESERVED full size buffers.
+  @param[in] size Number of data bytes the frame will hold, including the MIC.
+             Frames that fit into NWK_SMALL_BUFFER_SIZE are taken from the
+             small buffer pool while it has free buffers.
   @return Pointer to the frame or @c NULL if there are no free frames
 *****************************************************************************/
-NwkFrame_t *nwkFrameAlloc(void)
+NwkFrame_t *nwkFrameAlloc(uint8_t bufferClass, uint8_t size)
 {
-  for (uint8_t i = 0; i < NWK_BUFFERS_AMOUNT; i++)
+  NwkFrame_t *frame = NULL;
+
+  if (nwkFrameClassAmount[bufferClass] >= nwkFrameClassQuota[bufferClass])
+  {
+    nwkIb.stats.allocFailures[bufferClass]++;
+    return NULL;
+  }
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (size <= NWK_SMALL_BUFFER_SIZE && nwkFrameSmallFreeList)
+  {
+    frame = nwkFrameSmallFreeList;
+    nwkFrameSmallFreeList = frame->next;
+  }
+#else
+  (void)size;
+#endif
+
+  if (NULL == frame)
   {
-    if (NWK_FRAME_STATE_FREE == nwkFrameFrames[i].state)
+    if (NULL == nwkFrameFreeList ||
+        (NWK_BUFFER_CLASS_CONTROL != bufferClass && nwkFrameFreeAmount <= NWK_BUFFERS_CONTROL_RESERVED))
     {
-      memset(&nwkFrameFrames[i], 0, sizeof(NwkFrame_t));
-      nwkFrameFrames[i].size = sizeof(NwkFrameHeader_t);
-      nwkFrameFrames[i].payload = nwkFrameFrames[i].data + sizeof(NwkFrameHeader_t);
-      nwkIb.lock++;
-      return &nwkFrameFrames[i];
+      nwkIb.stats.allocFailures[bufferClass]++;
+      return NULL;
     }
+
+    frame = nwkFrameFreeList;
+    nwkFrameFreeList = frame->next;
+    nwkFrameFreeAmount--;
   }
-  return NULL;
+
+  nwkFrameClassAmount[bufferClass]++;
+
+  // Only the header and the control fields are cleared, payload area is
+  // always written by the user of the frame before it is used
+  memset(&frame->header, 0, sizeof(NwkFrameHeader_t));
+  memset(&frame->tx, 0, sizeof(frame->tx));
+
+  frame->next = NULL;
+  frame->bufferClass = bufferClass;
+  frame->size = sizeof(NwkFrameHeader_t);
+  frame->payload = frame->data + sizeof(NwkFrameHeader_t);
+  nwkIb.lock++;
+
+  return frame;
 }
 
 /*************************************************************************//**
@@ -100,6 +239,22 @@ NwkFrame_t *nwkFrameAlloc(void)
 void nwkFrameFree(NwkFrame_t *frame)
 {
   frame->state = NWK_FRAME_STATE_FREE;
+  nwkFrameClassAmount[frame->bufferClass]--;
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (nwkFrameIndex(frame) >= NWK_BUFFERS_AMOUNT)
+  {
+    frame->next = nwkFrameSmallFreeList;
+    nwkFrameSmallFreeList = frame;
+  }
+  else
+#endif
+  {
+    frame->next = nwkFrameFreeList;
+    nwkFrameFreeList = frame;
+    nwkFrameFreeAmount++;
+  }
+
   nwkIb.lock--;
 }
 
@@ -110,13 +265,12 @@ void nwkFrameFree(NwkFrame_t *frame)
 *****************************************************************************/
 NwkFrame_t *nwkFrameNext(NwkFrame_t *frame)
 {
-  if (NULL == frame)
-    frame = nwkFrameFrames;
-  else
-    frame++;
+  uint8_t i = (NULL == frame) ? 0 : nwkFrameIndex(frame) + 1;
 
-  for (; frame < &nwkFrameFrames[NWK_BUFFERS_AMOUNT]; frame++)
+  for (; i < NWK_BUFFERS_AMOUNT + NWK_SMALL_BUFFERS_AMOUNT; i++)
   {
+    frame = nwkFrameByIndex(i);
+
     if (NWK_FRAME_STATE_FREE != frame->state)
       return frame;
   }
@@ -131,9 +285,88 @@ NwkFrame_t *nwkFrameNext(NwkFrame_t *frame)
 void nwkFrameCommandInit(NwkFrame_t *frame)
 {
   frame->tx.status = NWK_SUCCESS_STATUS;
+  frame->tx.priority = NWK_PRIORITY_CONTROL;
   frame->header.nwkSeq = ++nwkIb.nwkSeqNum;
   frame->header.nwkSrcAddr = nwkIb.addr;
 #ifdef NWK_ENABLE_SECURE_COMMANDS
   frame->header.nwkFcf.security = 1;
 #endif
 }
+
+/*************************************************************************//**
+  @brief Initializes an empty frame @a queue
+  @param[in] queue Pointer to the queue
+*****************************************************************************/
+void nwkFrameQueueInit(NwkFrameQueue_t *queue)
+{
+  queue->head = NULL;
+  queue->tail = NULL;
+}
+
+/*************************************************************************//**
+  @brief Appends a @a frame to the tail of the @a queue
+  @param[in] queue Pointer to the queue
+  @param[in] frame Pointer to the frame, must not be a member of any queue
+*****************************************************************************/
+void nwkFrameQueuePush(NwkFrameQueue_t *queue, NwkFrame_t *frame)
+{
+  frame->next = NULL;
+
+  if (queue->tail)
+    queue->tail->next = frame;
+  else
+    queue->head = frame;
+
+  queue->tail = frame;
+}
+
+/*************************************************************************//**
+  @brief Removes a frame from the head of the @a queue
+  @param[in] queue Pointer to the queue
+  @return Pointer to the frame or @c NULL if the queue is empty
+*****************************************************************************/
+NwkFrame_t *nwkFrameQueuePop(NwkFrameQueue_t *queue)
+{
+  NwkFrame_t *frame = queue->head;
+
+  if (frame)
+  {
+    queue->head = frame->next;
+
+    if (NULL == queue->head)
+      queue->tail = NULL;
+
+    frame->next = NULL;
+  }
+
+  return frame;
+}
+
+/*************************************************************************//**
+  @brief Removes a @a frame from an arbitrary position in the @a queue
+  @param[in] queue Pointer to the queue
+  @param[in] frame Pointer to the frame
+*****************************************************************************/
+void nwkFrameQueueRemove(NwkFrameQueue_t *queue, NwkFrame_t *frame)
+{
+  NwkFrame_t *prev = NULL;
+
+  for (NwkFrame_t *iter = queue->head; iter; iter = iter->next)
+  {
+    if (iter == frame)
+    {
+      if (prev)
+        prev->next = frame->next;
+      else
+        queue->head = frame->next;
+
+      if (queue->tail == frame)
+        queue->tail = prev;
+
+      frame->next = NULL;
+      break;
+    }
+
+    prev = iter;
+  }
+}
@@ -225,7 +225,7 @@ static bool nwkRouteDiscoverySendRequest(NwkRouteDiscoveryTableEntry_t *entry, u
   NwkFrame_t *req;
   NwkCommandRouteRequest_t *command;
 
-  if (NULL == (req = nwkFrameAlloc()))
+  if (NULL == (req = nwkFrameAlloc(NWK_BUFFER_CLASS_CONTROL, NWK_FRAME_COMMAND_SIZE(NwkCommandRouteRequest_t))))
     return false;
 
   nwkFrameCommandInit(req);
@@ -315,7 +315,7 @@ static void nwkRouteDiscoverySendReply(NwkRouteDiscoveryTableEntry_t *entry, uin
   NwkFrame_t *req;
   NwkCommandRouteReply_t *command;
 
-  if (NULL == (req = nwkFrameAlloc()))
+  if (NULL == (req = nwkFrameAlloc(NWK_BUFFER_CLASS_CONTROL, NWK_FRAME_COMMAND_SIZE(NwkCommandRouteReply_t))))
     return;
 
   nwkFrameCommandInit(req);
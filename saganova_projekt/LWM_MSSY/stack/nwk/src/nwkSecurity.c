@@ -69,10 +69,9 @@ enum
 };
 
 /*- Variables --------------------------------------------------------------*/
-static uint8_t nwkSecurityActiveFrames;
+static NwkFrameQueue_t nwkSecurityQueue;
 static NwkFrame_t *nwkSecurityActiveFrame;
 static uint8_t nwkSecuritySize;
-static uint8_t nwkSecurityOffset;
 static bool nwkSecurityEncrypt;
 static uint32_t nwkSecurityVector[4];
 
@@ -83,7 +82,7 @@ static uint32_t nwkSecurityVector[4];
 *****************************************************************************/
 void nwkSecurityInit(void)
 {
-  nwkSecurityActiveFrames = 0;
+  nwkFrameQueueInit(&nwkSecurityQueue);
   nwkSecurityActiveFrame = NULL;
 }
 
@@ -102,7 +101,7 @@ void nwkSecurityProcess(NwkFrame_t *frame, bool encrypt)
     frame->state = NWK_SECURITY_STATE_ENCRYPT_PENDING;
   else
     frame->state = NWK_SECURITY_STATE_DECRYPT_PENDING;
-  ++nwkSecurityActiveFrames;
+  nwkFrameQueuePush(&nwkSecurityQueue, frame);
 }
 
 /*************************************************************************//**
@@ -110,56 +109,40 @@ void nwkSecurityProcess(NwkFrame_t *frame, bool encrypt)
 static void nwkSecurityStart(void)
 {
   NwkFrameHeader_t *header = &nwkSecurityActiveFrame->header;
+  uint8_t attempt = header->nwkFcf.attempt;
+
+  // Retransmissions reuse the encrypted frame, so the attempt is not covered by MIC
+  header->nwkFcf.attempt = 0;
 
   nwkSecurityVector[0] = header->nwkSeq;
   nwkSecurityVector[1] = ((uint32_t)header->nwkDstAddr << 16) | header->nwkDstEndpoint;
   nwkSecurityVector[2] = ((uint32_t)header->nwkSrcAddr << 16) | header->nwkSrcEndpoint;
   nwkSecurityVector[3] = ((uint32_t)header->macDstPanId << 16) | *(uint8_t *)&header->nwkFcf;
 
+  header->nwkFcf.attempt = attempt;
+
   if (NWK_SECURITY_STATE_DECRYPT_PENDING == nwkSecurityActiveFrame->state)
     nwkSecurityActiveFrame->size -= NWK_SECURITY_MIC_SIZE;
 
   nwkSecuritySize = nwkFramePayloadSize(nwkSecurityActiveFrame);
-  nwkSecurityOffset = 0;
   nwkSecurityEncrypt = (NWK_SECURITY_STATE_ENCRYPT_PENDING == nwkSecurityActiveFrame->state);
 
   nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_PROCESS;
 }
 
 /*************************************************************************//**
+  @brief Called when the whole payload of the active frame is processed
 *****************************************************************************/
 void SYS_EncryptConf(void)
 {
-  uint8_t *vector = (uint8_t *)nwkSecurityVector;
-  uint8_t *text = &nwkSecurityActiveFrame->payload[nwkSecurityOffset];
-  uint8_t block;
-
-  block = (nwkSecuritySize < NWK_SECURITY_BLOCK_SIZE) ? nwkSecuritySize : NWK_SECURITY_BLOCK_SIZE;
-
-  for (uint8_t i = 0; i < block; i++)
-  {
-    text[i] ^= vector[i];
-
-    if (nwkSecurityEncrypt)
-      vector[i] = text[i];
-    else
-      vector[i] ^= text[i];
-  }
-
-  nwkSecurityOffset += block;
-  nwkSecuritySize -= block;
-
-  if (nwkSecuritySize > 0)
-    nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_PROCESS;
-  else
-    nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_CONFIRM;
+  nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_CONFIRM;
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 static bool nwkSecurityProcessMic(void)
 {
-  uint8_t *mic = &nwkSecurityActiveFrame->payload[nwkSecurityOffset];
+  uint8_t *mic = &nwkSecurityActiveFrame->payload[nwkSecuritySize];
   uint32_t vmic = nwkSecurityVector[0] ^ nwkSecurityVector[1] ^
                   nwkSecurityVector[2] ^ nwkSecurityVector[3];
   uint32_t tmic;
@@ -182,11 +165,6 @@ static bool nwkSecurityProcessMic(void)
 *****************************************************************************/
 void nwkSecurityTaskHandler(void)
 {
-  NwkFrame_t *frame = NULL;
-
-  if (0 == nwkSecurityActiveFrames)
-    return;
-
   if (nwkSecurityActiveFrame)
   {
     if (NWK_SECURITY_STATE_CONFIRM == nwkSecurityActiveFrame->state)
@@ -199,27 +177,19 @@ void nwkSecurityTaskHandler(void)
         nwkRxDecryptConf(nwkSecurityActiveFrame, micStatus);
 
       nwkSecurityActiveFrame = NULL;
-      --nwkSecurityActiveFrames;
     }
     else if (NWK_SECURITY_STATE_PROCESS == nwkSecurityActiveFrame->state)
     {
       nwkSecurityActiveFrame->state = NWK_SECURITY_STATE_WAIT;
-      SYS_EncryptReq((uint8_t *)nwkSecurityVector, (uint8_t *)nwkIb.key);
+      SYS_EncryptReq((uint8_t *)nwkSecurityVector, nwkSecurityActiveFrame->payload,
+          nwkSecuritySize, (uint8_t *)nwkIb.key, nwkSecurityEncrypt);
     }
 
     return;
   }
 
-  while (NULL != (frame = nwkFrameNext(frame)))
-  {
-    if (NWK_SECURITY_STATE_ENCRYPT_PENDING == frame->state ||
-        NWK_SECURITY_STATE_DECRYPT_PENDING == frame->state)
-    {
-      nwkSecurityActiveFrame = frame;
-      nwkSecurityStart();
-      return;
-    }
-  }
+  if (NULL != (nwkSecurityActiveFrame = nwkFrameQueuePop(&nwkSecurityQueue)))
+    nwkSecurityStart();
 }
 
 #endif // NWK_ENABLE_SECURITY
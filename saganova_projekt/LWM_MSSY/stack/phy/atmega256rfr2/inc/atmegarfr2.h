@@ -59,6 +59,25 @@
 // Typed memory access macro
 #define MMIO_REG(mem_addr, type) (*(volatile type *)(mem_addr))
 
+// Symbol Counter Control Register 0
+#define SCCR0_REG       MMIO_REG(0xDC, uint8_t)
+#define SCCR0_REG_s     MMIO_REG(0xDC, struct __struct_SCCR0_REG)
+struct __struct_SCCR0_REG
+{
+  uint8_t sccmp   : 3; // Symbol Counter Compare Unit Mode Select
+  uint8_t sctse   : 1; // Symbol Counter Automatic Timestamping Enable
+  uint8_t sccksel : 1; // Symbol Counter Clock Source Select
+  uint8_t scen    : 1; // Symbol Counter Enable
+  uint8_t scmbts  : 1; // Manual Beacon Timestamp
+  uint8_t scres   : 1; // Symbol Counter Synchronization
+};
+
+// Symbol Counter Register, reading index 0 latches the upper bytes
+#define SCCNT_REG(index) MMIO_REG(0xE1 + (index), uint8_t)
+
+// Symbol Counter Frame Timestamp Register (SFD of the last received frame)
+#define SCTSR_REG(index) MMIO_REG(0xE9 + (index), uint8_t)
+
 // Transceiver Pin Register
 #define TRXPR_REG       MMIO_REG(0x139, uint8_t)
 #define TRXPR_REG_s     MMIO_REG(0x139, struct __struct_TRXPR_REG)
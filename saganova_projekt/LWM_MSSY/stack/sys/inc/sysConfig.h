@@ -55,10 +55,40 @@
 #define NWK_BUFFERS_AMOUNT                       5
 #endif
 
+#ifndef NWK_SMALL_BUFFERS_AMOUNT
+#define NWK_SMALL_BUFFERS_AMOUNT                 4
+#endif
+
+#ifndef NWK_SMALL_BUFFER_SIZE
+#define NWK_SMALL_BUFFER_SIZE                    32 // bytes, header + command + MIC
+#endif
+
+#ifndef NWK_BUFFERS_CONTROL_RESERVED
+#define NWK_BUFFERS_CONTROL_RESERVED             1
+#endif
+
+// By default outgoing data and received frames split the unreserved buffers,
+// so that neither of them can take all buffers from the other
+#ifndef NWK_BUFFERS_DATA_QUOTA
+#define NWK_BUFFERS_DATA_QUOTA                   ((NWK_BUFFERS_AMOUNT - NWK_BUFFERS_CONTROL_RESERVED) / 2)
+#endif
+
+#ifndef NWK_BUFFERS_RX_QUOTA
+#define NWK_BUFFERS_RX_QUOTA                     (NWK_BUFFERS_AMOUNT - NWK_BUFFERS_CONTROL_RESERVED - NWK_BUFFERS_DATA_QUOTA)
+#endif
+
+#ifndef NWK_BUFFERS_REBROADCAST_QUOTA
+#define NWK_BUFFERS_REBROADCAST_QUOTA            ((NWK_BUFFERS_AMOUNT + 1) / 2)
+#endif
+
 #ifndef NWK_DUPLICATE_REJECTION_TABLE_SIZE
 #define NWK_DUPLICATE_REJECTION_TABLE_SIZE       10
 #endif
 
+#ifndef NWK_DUPLICATE_REJECTION_WINDOW
+#define NWK_DUPLICATE_REJECTION_WINDOW           8 // sequence numbers per source
+#endif
+
 #ifndef NWK_DUPLICATE_REJECTION_TTL
 #define NWK_DUPLICATE_REJECTION_TTL              1000 // ms
 #endif
@@ -75,6 +105,54 @@
 #define NWK_ACK_WAIT_TIME                        1000 // ms
 #endif
 
+#ifndef NWK_BROADCAST_JITTER
+#define NWK_BROADCAST_JITTER                     80 // ms
+#endif
+
+#ifndef NWK_BROADCAST_SUPPRESSION_COPIES
+#define NWK_BROADCAST_SUPPRESSION_COPIES         2 // copies heard before a rebroadcast is cancelled
+#endif
+
+#ifndef NWK_BROADCAST_JITTER_MAX_SCALE
+#define NWK_BROADCAST_JITTER_MAX_SCALE           4 // 1 disables density scaling
+#endif
+
+#ifndef NWK_ACK_RETRIES
+#define NWK_ACK_RETRIES                          0
+#endif
+
+#ifndef NWK_ACK_RETRY_BACKOFF
+#define NWK_ACK_RETRY_BACKOFF                    20 // ms, doubled with every retry
+#endif
+
+#ifndef NWK_ACK_WAIT_TIME_MIN
+#define NWK_ACK_WAIT_TIME_MIN                    100 // ms
+#endif
+
+#ifndef NWK_ACK_WAIT_TIME_MAX
+#define NWK_ACK_WAIT_TIME_MAX                    NWK_ACK_WAIT_TIME
+#endif
+
+#ifndef NWK_ACK_WINDOW
+#define NWK_ACK_WINDOW                           8 // frames in flight per destination
+#endif
+
+#ifndef NWK_BLOCK_ACK_DELAY
+#define NWK_BLOCK_ACK_DELAY                      10 // ms
+#endif
+
+#ifndef NWK_BLOCK_ACK_TABLE_SIZE
+#define NWK_BLOCK_ACK_TABLE_SIZE                 4
+#endif
+
+#ifndef NWK_AGGREGATION_TIMEOUT
+#define NWK_AGGREGATION_TIMEOUT                  50 // ms
+#endif
+
+#ifndef NWK_AGGREGATION_RX_TABLE_SIZE
+#define NWK_AGGREGATION_RX_TABLE_SIZE            2 // partially accepted aggregates
+#endif
+
 #ifndef NWK_GROUPS_AMOUNT
 #define NWK_GROUPS_AMOUNT                        10
 #endif
@@ -87,17 +165,166 @@
 #define NWK_ROUTE_DISCOVERY_TIMEOUT              1000 // ms
 #endif
 
+#ifndef NWK_RX_HIGH_WATERMARK
+#define NWK_RX_HIGH_WATERMARK                    ((NWK_BUFFERS_RX_QUOTA * 3) / 4) // RX buffers in use
+#endif
+
+#ifndef NWK_RX_LOW_WATERMARK
+#define NWK_RX_LOW_WATERMARK                     (NWK_BUFFERS_RX_QUOTA / 4)
+#endif
+
+#ifndef NWK_CONGESTION_BACKOFF_TIME
+#define NWK_CONGESTION_BACKOFF_TIME              100 // ms
+#endif
+
+#ifndef NWK_CONGESTION_TABLE_SIZE
+#define NWK_CONGESTION_TABLE_SIZE                4 // congested destinations
+#endif
+
+#ifndef PHY_RX_QUEUE_SIZE
+#define PHY_RX_QUEUE_SIZE                        4 // frames
+#endif
+
 //#define NWK_ENABLE_ROUTING
 //#define NWK_ENABLE_SECURITY
 //#define NWK_ENABLE_MULTICAST
 //#define NWK_ENABLE_ROUTE_DISCOVERY
 //#define NWK_ENABLE_SECURE_COMMANDS
+//#define NWK_ENABLE_WEIGHTED_PRIORITY
+//#define NWK_ENABLE_AGGREGATION
+//#define NWK_ENABLE_FRAGMENTATION
+//#define NWK_ENABLE_BLOCK_ACK
+//#define NWK_ENABLE_ADAPTIVE_ACK_WAIT
+//#define NWK_ENABLE_BROADCAST_SUPPRESSION
+//#define NWK_ENABLE_CONGESTION_CONTROL
+//#define PHY_ENABLE_RX_QUEUE
+
+#ifndef NWK_PRIORITY_WEIGHTS
+#define NWK_PRIORITY_WEIGHTS                     { 1, 2, 4, 8 } // DATA, ROUTED, ACK, CONTROL
+#endif
+
+#ifndef NWK_FRAG_ENDPOINT
+#define NWK_FRAG_ENDPOINT                        15
+#endif
+
+#ifndef NWK_FRAG_WINDOW
+#define NWK_FRAG_WINDOW                          4 // fragments per acknowledgement
+#endif
+
+#ifndef NWK_FRAG_MAX_FRAGMENTS
+#define NWK_FRAG_MAX_FRAGMENTS                   32
+#endif
+
+#ifndef NWK_FRAG_RX_BUFFERS_AMOUNT
+#define NWK_FRAG_RX_BUFFERS_AMOUNT               1
+#endif
+
+#ifndef NWK_FRAG_RX_BUFFER_SIZE
+#define NWK_FRAG_RX_BUFFER_SIZE                  2048 // bytes
+#endif
+
+#ifndef NWK_FRAG_ACK_TIMEOUT
+#define NWK_FRAG_ACK_TIMEOUT                     300 // ms
+#endif
+
+#ifndef NWK_FRAG_ACK_DELAY
+#define NWK_FRAG_ACK_DELAY                       10 // ms
+#endif
+
+#ifndef NWK_FRAG_MAX_RETRIES
+#define NWK_FRAG_MAX_RETRIES                     5
+#endif
+
+#ifndef NWK_FRAG_REASSEMBLY_TIMEOUT
+#define NWK_FRAG_REASSEMBLY_TIMEOUT              3000 // ms
+#endif
 
 #ifndef SYS_SECURITY_MODE
 #define SYS_SECURITY_MODE                        0
 #endif
 
 /*- Sanity checks ----------------------------------------------------------*/
+#if NWK_SMALL_BUFFERS_AMOUNT > 0 && NWK_SMALL_BUFFER_SIZE < 28
+  #error NWK_SMALL_BUFFER_SIZE must fit the largest command frame (28 bytes)
+#endif
+
+#if NWK_BUFFERS_CONTROL_RESERVED >= NWK_BUFFERS_AMOUNT
+  #error NWK_BUFFERS_CONTROL_RESERVED must be less than NWK_BUFFERS_AMOUNT
+#endif
+
+#if NWK_BUFFERS_RX_QUOTA < 1 || NWK_BUFFERS_DATA_QUOTA < 1
+  #error NWK_BUFFERS_RX_QUOTA and NWK_BUFFERS_DATA_QUOTA must be at least 1
+#endif
+
+#if NWK_DUPLICATE_REJECTION_TABLE_SIZE < 1
+  #error NWK_DUPLICATE_REJECTION_TABLE_SIZE must be at least 1
+#endif
+
+#if NWK_DUPLICATE_REJECTION_WINDOW != 8 && NWK_DUPLICATE_REJECTION_WINDOW != 16 && \
+    NWK_DUPLICATE_REJECTION_WINDOW != 32 && NWK_DUPLICATE_REJECTION_WINDOW != 64
+  #error NWK_DUPLICATE_REJECTION_WINDOW must be 8, 16, 32 or 64
+#endif
+
+#if NWK_BROADCAST_JITTER < 1
+  #error NWK_BROADCAST_JITTER must be at least 1 ms
+#endif
+
+#if defined(NWK_ENABLE_BROADCAST_SUPPRESSION) && (NWK_BROADCAST_SUPPRESSION_COPIES < 1 || NWK_BROADCAST_SUPPRESSION_COPIES > 255)
+  #error NWK_BROADCAST_SUPPRESSION_COPIES must be in range 1..255
+#endif
+
+#if defined(NWK_ENABLE_BROADCAST_SUPPRESSION) && (NWK_BROADCAST_JITTER_MAX_SCALE < 1 || NWK_BROADCAST_JITTER * NWK_BROADCAST_JITTER_MAX_SCALE > 65535)
+  #error NWK_BROADCAST_JITTER * NWK_BROADCAST_JITTER_MAX_SCALE must be in range NWK_BROADCAST_JITTER..65535
+#endif
+
+#if NWK_ACK_RETRIES > 3
+  #error NWK_ACK_RETRIES must be in range 0..3
+#endif
+
+#if NWK_ACK_RETRIES > 0 && NWK_ACK_RETRY_BACKOFF < 1
+  #error NWK_ACK_RETRY_BACKOFF must be at least 1 ms
+#endif
+
+#if NWK_ACK_RETRIES > 0 && (NWK_ACK_RETRIES + 1) * (NWK_ACK_WAIT_TIME + 2 * (NWK_ACK_RETRY_BACKOFF << NWK_ACK_RETRIES)) > 25000
+  #error NWK_ACK_WAIT_TIME is too long for NWK_ACK_RETRIES, retransmissions would not be detected as duplicates
+#endif
+
+#if NWK_ACK_RETRIES > 0 && (NWK_ACK_WINDOW < 1 || NWK_ACK_WINDOW > NWK_DUPLICATE_REJECTION_WINDOW)
+  #error NWK_ACK_WINDOW must be in range 1..NWK_DUPLICATE_REJECTION_WINDOW to keep retransmissions inside the duplicate rejection window
+#endif
+
+#if defined(NWK_ENABLE_ADAPTIVE_ACK_WAIT) && !defined(NWK_ENABLE_ROUTING)
+  #error NWK_ENABLE_ADAPTIVE_ACK_WAIT requires NWK_ENABLE_ROUTING, estimations are kept in the routing table
+#endif
+
+#if defined(NWK_ENABLE_ADAPTIVE_ACK_WAIT) && (NWK_ACK_WAIT_TIME_MAX > 8000 || NWK_ACK_WAIT_TIME_MIN > NWK_ACK_WAIT_TIME_MAX)
+  #error NWK_ACK_WAIT_TIME_MAX must be in range NWK_ACK_WAIT_TIME_MIN..8000
+#endif
+
+#if defined(NWK_ENABLE_BLOCK_ACK) && (NWK_ACK_WINDOW < 1 || NWK_ACK_WINDOW > 9)
+  #error NWK_ACK_WINDOW must be in range 1..9 to fit into a block acknowledgement
+#endif
+
+#if defined(NWK_ENABLE_ROUTING) && (NWK_ROUTE_TABLE_SIZE < 1 || NWK_ROUTE_TABLE_SIZE > 32767)
+  #error NWK_ROUTE_TABLE_SIZE must be in range 1..32767
+#endif
+
+#if defined(NWK_ENABLE_CONGESTION_CONTROL) && (NWK_RX_LOW_WATERMARK >= NWK_RX_HIGH_WATERMARK || NWK_RX_HIGH_WATERMARK > NWK_BUFFERS_RX_QUOTA)
+  #error NWK_RX_LOW_WATERMARK must be less than NWK_RX_HIGH_WATERMARK, which must not exceed NWK_BUFFERS_RX_QUOTA
+#endif
+
+#if defined(NWK_ENABLE_CONGESTION_CONTROL) && NWK_CONGESTION_TABLE_SIZE < 1
+  #error NWK_CONGESTION_TABLE_SIZE must be at least 1
+#endif
+
+#if defined(PHY_ENABLE_RX_QUEUE) && (PHY_RX_QUEUE_SIZE < 1 || PHY_RX_QUEUE_SIZE > 128 || (PHY_RX_QUEUE_SIZE & (PHY_RX_QUEUE_SIZE - 1)))
+  #error PHY_RX_QUEUE_SIZE must be a power of 2 in range 1..128
+#endif
+
+#if defined(NWK_ENABLE_FRAGMENTATION) && (NWK_FRAG_MAX_FRAGMENTS > 255 || NWK_FRAG_WINDOW > NWK_FRAG_MAX_FRAGMENTS)
+  #error NWK_FRAG_MAX_FRAGMENTS must be in range NWK_FRAG_WINDOW..255
+#endif
+
 #if defined(NWK_ENABLE_SECURITY) && (SYS_SECURITY_MODE == 0)
   #define PHY_ENABLE_AES_MODULE
 #endif
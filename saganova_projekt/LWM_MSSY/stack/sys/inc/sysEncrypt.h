@@ -52,7 +52,8 @@
 #include <stdbool.h>
 
 /*- Prototypes -------------------------------------------------------------*/
-void SYS_EncryptReq(uint8_t *text, uint8_t *key);
+void SYS_EncryptReq(uint8_t *vector, uint8_t *text, uint8_t size, uint8_t *key,
+    bool encrypt);
 void SYS_EncryptConf(void);
 
 #endif // _SYS_ENCRYPT_H_
@@ -55,6 +55,7 @@ static void placeTimer(SYS_Timer_t *timer);
 
 /*- Variables --------------------------------------------------------------*/
 static SYS_Timer_t *timers;
+static uint32_t sysTimerTime;
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -63,6 +64,16 @@ static SYS_Timer_t *timers;
 void SYS_TimerInit(void)
 {
   timers = NULL;
+  sysTimerTime = 0;
+}
+
+/*************************************************************************//**
+  @brief Returns the time since initialization in milliseconds, the value
+         advances in HAL_TIMER_INTERVAL steps from SYS_TimerTaskHandler()
+*****************************************************************************/
+uint32_t SYS_TimerGetTime(void)
+{
+  return sysTimerTime;
 }
 
 /*************************************************************************//**
@@ -123,6 +134,7 @@ void SYS_TimerTaskHandler(void)
   ATOMIC_SECTION_LEAVE
 
   elapsed = cnt * HAL_TIMER_INTERVAL;
+  sysTimerTime += elapsed;
 
   while (timers && (timers->timeout <= elapsed))
   {
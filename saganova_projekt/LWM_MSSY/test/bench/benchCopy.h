@@ -0,0 +1,25 @@
+/**
+ * \file benchCopy.h
+ *
+ * \brief Counts the bytes copied with memcpy() by the sources it is
+ *        included into
+ *
+ */
+
+#ifndef _BENCH_COPY_H_
+#define _BENCH_COPY_H_
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stddef.h>
+#include <string.h>
+
+/*- Definitions ------------------------------------------------------------*/
+#define memcpy benchMemcpy
+
+/*- Variables --------------------------------------------------------------*/
+extern unsigned long benchCopied;
+
+/*- Prototypes -------------------------------------------------------------*/
+void *benchMemcpy(void *dst, const void *src, size_t size);
+
+#endif // _BENCH_COPY_H_
@@ -0,0 +1,137 @@
+/**
+ * \file benchDataReq.c
+ *
+ * \brief Host benchmark of the bytes copied per outgoing data request
+ *
+ * Each message is built the way the Salsa20 sender builds it, an 8 byte
+ * nonce followed by the encrypted payload, and is sent either through
+ * NWK_DataReq() from a staging buffer or written in place with
+ * NWK_DataReqAlloc() and NWK_DataReqCommit(). Bytes copied by the
+ * application and by nwkDataReq.c are counted up to nwkTxFrame().
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdio.h>
+#include "benchCopy.h"
+#include "nwk.h"
+#include "nwkTx.h"
+#include "nwkFrame.h"
+#include "nwkDataReq.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define BENCH_MESSAGES       1000
+#define BENCH_NONCE_SIZE     8
+#define BENCH_MAX_SIZE       100
+
+/*- Variables --------------------------------------------------------------*/
+NwkIb_t nwkIb;
+unsigned long benchCopied;
+
+static uint8_t benchUart[BENCH_MAX_SIZE];
+static uint8_t benchStaging[BENCH_NONCE_SIZE + BENCH_MAX_SIZE];
+static uint8_t benchNonce[BENCH_NONCE_SIZE];
+static NWK_DataReq_t benchReq;
+static bool benchConfirmed;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Counting replacement of memcpy()
+*****************************************************************************/
+void *benchMemcpy(void *dst, const void *src, size_t size)
+{
+  benchCopied += size;
+  return __builtin_memcpy(dst, src, size);
+}
+
+/*************************************************************************//**
+  @brief Sends the frame, the transmission always succeeds
+*****************************************************************************/
+void nwkTxFrame(NwkFrame_t *frame)
+{
+  frame->tx.status = NWK_SUCCESS_STATUS;
+  frame->tx.confirm(frame);
+}
+
+/*************************************************************************//**
+  @brief Encrypts @a size bytes from @a in to @a out, stands in for Salsa20
+*****************************************************************************/
+static void benchEncrypt(const uint8_t *in, uint8_t *out, uint8_t size)
+{
+  for (uint8_t i = 0; i < size; i++)
+    out[i] = in[i] ^ 0x5a;
+}
+
+/*************************************************************************//**
+  @brief Data request confirmation handler
+*****************************************************************************/
+static void benchDataConf(NWK_DataReq_t *req)
+{
+  (void)req;
+  benchConfirmed = true;
+}
+
+/*************************************************************************//**
+  @brief Sends one message of @a size bytes
+*****************************************************************************/
+static void benchSend(uint8_t size, bool inPlace)
+{
+  benchReq.dstAddr = 0;
+  benchReq.options = 0;
+  benchReq.confirm = benchDataConf;
+
+  if (inPlace)
+  {
+    uint8_t *payload = NWK_DataReqAlloc(&benchReq);
+
+    memcpy(payload, benchNonce, BENCH_NONCE_SIZE);
+    benchEncrypt(benchUart, payload + BENCH_NONCE_SIZE, size);
+    benchReq.size = BENCH_NONCE_SIZE + size;
+    NWK_DataReqCommit(&benchReq);
+  }
+  else
+  {
+    memcpy(benchStaging, benchNonce, BENCH_NONCE_SIZE);
+    benchEncrypt(benchUart, benchStaging + BENCH_NONCE_SIZE, size);
+    benchReq.data = benchStaging;
+    benchReq.size = BENCH_NONCE_SIZE + size;
+    NWK_DataReq(&benchReq);
+  }
+
+  benchConfirmed = false;
+
+  while (!benchConfirmed)
+    nwkDataReqTaskHandler();
+}
+
+/*************************************************************************//**
+  @brief Benchmark entry point
+*****************************************************************************/
+int main(void)
+{
+  nwkFrameInit();
+  nwkDataReqInit();
+
+  printf("payload   NWK_DataReq   NWK_DataReqAlloc   (bytes copied per message)\n");
+
+  for (uint8_t size = 16; size <= 96; size += 40)
+  {
+    unsigned long copied[2];
+
+    for (int inPlace = 0; inPlace < 2; inPlace++)
+    {
+      benchCopied = 0;
+
+      for (int i = 0; i < BENCH_MESSAGES; i++)
+        benchSend(size, inPlace);
+
+      copied[inPlace] = benchCopied;
+    }
+
+    printf("  %3d B   %11.1f   %16.1f\n", size,
+        (double)copied[0] / BENCH_MESSAGES, (double)copied[1] / BENCH_MESSAGES);
+  }
+
+  return 0;
+}
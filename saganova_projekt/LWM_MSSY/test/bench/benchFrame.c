@@ -0,0 +1,78 @@
+/**
+ * \file benchFrame.c
+ *
+ * \brief Host benchmark of the NWK frame buffer pool
+ *
+ * All buffers but one are held, which is the worst case for a pool that is
+ * scanned. The remaining buffer is then allocated and released in a loop.
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdio.h>
+#include <time.h>
+#include "nwk.h"
+#include "nwkFrame.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define BENCH_ITERATIONS     5000000l
+#define BENCH_FRAME_BUSY     0xff
+
+// Stacks before the buffer classes were added take no arguments
+#ifdef BENCH_FRAME_ALLOC_NO_CLASS
+  #define benchFrameAlloc() nwkFrameAlloc()
+#else
+  #define benchFrameAlloc() nwkFrameAlloc(NWK_BUFFER_CLASS_CONTROL, NWK_FRAME_MAX_PAYLOAD_SIZE)
+#endif
+
+/*- Variables --------------------------------------------------------------*/
+NwkIb_t nwkIb;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Returns monotonic time in nanoseconds
+*****************************************************************************/
+static double benchTime(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*************************************************************************//**
+  @brief Benchmark entry point
+*****************************************************************************/
+int main(void)
+{
+  double start, time;
+
+  nwkFrameInit();
+
+  for (int i = 0; i < NWK_BUFFERS_AMOUNT - 1; i++)
+    benchFrameAlloc()->state = BENCH_FRAME_BUSY;
+
+  start = benchTime();
+
+  for (long i = 0; i < BENCH_ITERATIONS; i++)
+  {
+    NwkFrame_t *frame = benchFrameAlloc();
+
+    if (NULL == frame)
+    {
+      printf("allocation failed\n");
+      return 1;
+    }
+
+    frame->state = BENCH_FRAME_BUSY;
+    nwkFrameFree(frame);
+  }
+
+  time = benchTime() - start;
+
+  printf("frame pool, %3d buffers: %6.1f ns per alloc/free\n",
+      NWK_BUFFERS_AMOUNT, time / BENCH_ITERATIONS);
+
+  return 0;
+}
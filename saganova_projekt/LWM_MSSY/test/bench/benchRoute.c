@@ -0,0 +1,115 @@
+/**
+ * \file benchRoute.c
+ *
+ * \brief Host benchmark of the route table
+ *
+ * The table is filled through nwkRouteFrameReceived(), as the stack does.
+ * A frame is the forwarding path of one frame: the source is learned, the
+ * next hop looked up, the frame prepared and confirmed. A lookup is one
+ * NWK_RouteFindEntry() call, 10% of them for unknown destinations.
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nwk.h"
+#include "nwkTx.h"
+#include "nwkFrame.h"
+#include "nwkGroup.h"
+#include "nwkRoute.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define BENCH_FRAMES         2000000l
+#define BENCH_LOOKUPS        20000000l
+#define BENCH_KEYS           65536
+#define BENCH_ADDR(i)        (0x100 + (i) * 7)
+
+/*- Variables --------------------------------------------------------------*/
+NwkIb_t nwkIb;
+
+static NwkFrame_t benchFrame;
+static uint16_t benchKeys[BENCH_KEYS];
+
+/*- Implementations --------------------------------------------------------*/
+
+void nwkTxFrame(NwkFrame_t *frame) { (void)frame; }
+void nwkFrameFree(NwkFrame_t *frame) { (void)frame; }
+NwkFrame_t *nwkFrameAlloc(uint8_t bufferClass, uint8_t size) { (void)bufferClass; (void)size; return NULL; }
+void nwkFrameCommandInit(NwkFrame_t *frame) { (void)frame; }
+bool NWK_GroupIsMember(uint16_t group) { (void)group; return false; }
+
+/*************************************************************************//**
+  @brief Returns monotonic time in nanoseconds
+*****************************************************************************/
+static double benchTime(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*************************************************************************//**
+  @brief Prepares the benchmark frame as received from @a src for @a dst
+*****************************************************************************/
+static void benchReceive(uint16_t src, uint16_t dst)
+{
+  memset(&benchFrame.header, 0, sizeof(benchFrame.header));
+  benchFrame.header.macDstPanId = 0x1234;
+  benchFrame.header.macDstAddr = 1;
+  benchFrame.header.macSrcAddr = src;
+  benchFrame.header.nwkSrcAddr = src;
+  benchFrame.header.nwkDstAddr = dst;
+  benchFrame.rx.lqi = 200;
+  nwkRouteFrameReceived(&benchFrame);
+}
+
+/*************************************************************************//**
+  @brief Benchmark entry point
+*****************************************************************************/
+int main(void)
+{
+  double start, frameTime, lookupTime;
+  long routed = 0, found = 0;
+
+  nwkIb.addr = 1;
+  nwkRouteInit();
+
+  for (int i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
+    benchReceive(BENCH_ADDR(i), 1);
+
+  srand(1);
+  start = benchTime();
+
+  for (long n = 0; n < BENCH_FRAMES; n++)
+  {
+    uint16_t dst = BENCH_ADDR(rand() % NWK_ROUTE_TABLE_SIZE);
+
+    benchReceive(BENCH_ADDR(rand() % NWK_ROUTE_TABLE_SIZE), dst);
+    routed += NWK_ROUTE_UNKNOWN != NWK_RouteNextHop(dst, 0);
+    nwkRoutePrepareTx(&benchFrame);
+    benchFrame.tx.status = NWK_SUCCESS_STATUS;
+    nwkRouteFrameSent(&benchFrame);
+  }
+
+  frameTime = benchTime() - start;
+
+  for (int i = 0; i < BENCH_KEYS; i++)
+    benchKeys[i] = BENCH_ADDR(rand() % NWK_ROUTE_TABLE_SIZE) + (0 == rand() % 10);
+
+  start = benchTime();
+
+  for (long n = 0; n < BENCH_LOOKUPS; n++)
+    found += NULL != NWK_RouteFindEntry(benchKeys[n % BENCH_KEYS], 0);
+
+  lookupTime = benchTime() - start;
+
+  printf("route table, %4d entries: %7.1f ns per frame, %6.1f ns per lookup "
+      "(%ld routed, %ld found)\n", NWK_ROUTE_TABLE_SIZE, frameTime / BENCH_FRAMES,
+      lookupTime / BENCH_LOOKUPS, routed, found);
+
+  return 0;
+}
@@ -0,0 +1,17 @@
+/**
+ * \file config.h
+ *
+ * \brief Stack configuration for the host benchmarks
+ *
+ * Only the options the benchmarks need are set here. Sizes are passed on
+ * the command line by the Makefile.
+ *
+ */
+
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_ENABLE_ROUTING
+
+#endif // _CONFIG_H_
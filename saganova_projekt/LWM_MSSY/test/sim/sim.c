@@ -0,0 +1,1523 @@
+/**
+ * \file sim.c
+ *
+ * \brief Network simulation of several nodes running the NWK stack
+ *
+ * Every node is a private copy of the stack library built from simPhy.c
+ * and the stack sources, so each one has its own state. Nodes share a
+ * medium with configurable links and loss. Time advances in 1 ms steps;
+ * every step each node runs a few main loop passes and gets its timer
+ * interrupt every HAL_TIMER_INTERVAL ms.
+ *
+ * Usage: sim <node library> <work directory> [test ...]
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <dlfcn.h>
+#include "nwk.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define SIM_MAX_NODES          16
+#define SIM_MAX_REQUESTS       64
+#define SIM_MAX_PAYLOAD        120
+#define SIM_MEDIUM_QUEUE_SIZE  4096
+#define SIM_PASSES_PER_MS      3
+#define SIM_PAN_ID             0x1234
+#define SIM_ENDPOINT           1
+#define SIM_LQI                200
+
+#define SIM_CHECK(c) do { if (!(c)) { \
+    printf("FAIL %s:%d %s\n", __func__, __LINE__, #c); simFailures++; } } while (0)
+
+/*- Types ------------------------------------------------------------------*/
+typedef void (*SimMediumTx_t)(void *node, uint8_t *data, uint8_t size);
+
+typedef struct SimNode_t
+{
+  void       *lib;
+  int        id;
+
+  void       (*init)(void *node, SimMediumTx_t mediumTx);
+  void       (*task)(void);
+  void       (*tick)(void);
+  void       (*rx)(uint8_t *data, uint8_t size, uint8_t lqi);
+  uint16_t   (*lock)(void);
+  void       (*setAddr)(uint16_t addr);
+  void       (*setPanId)(uint16_t panId);
+  void       (*setRxState)(bool rx);
+  void       (*openEndpoint)(uint8_t id, bool (*handler)(NWK_DataInd_t *ind));
+  void       (*dataReq)(NWK_DataReq_t *req);
+  NWK_Stats_t *(*stats)(void);
+  int        *txCount;
+  int        *taskPasses;
+  bool       *promiscuous;
+
+  int        rxPass;
+  int        received;
+  int        receivedBytes;
+  uint64_t   seen;
+  int        lastIndex;
+  uint32_t   lastTxTime;
+} SimNode_t;
+
+typedef struct SimPacket_t
+{
+  int        from;
+  uint8_t    data[128];
+  uint8_t    size;
+} SimPacket_t;
+
+typedef struct SimTest_t
+{
+  const char *name;
+  void       (*run)(void);
+} SimTest_t;
+
+/*- Variables --------------------------------------------------------------*/
+static const char *simLibPath;
+static const char *simWorkDir;
+static SimNode_t simNodes[SIM_MAX_NODES];
+static int simNodesAmount;
+static int simCurrent;
+static int simTickInterval;
+static uint32_t simTime;
+static int simFailures;
+
+static bool simLink[SIM_MAX_NODES][SIM_MAX_NODES];
+static int simLossPercent;
+static SimPacket_t simMedium[SIM_MEDIUM_QUEUE_SIZE];
+static unsigned simMediumHead, simMediumTail;
+
+static bool simTxLogEnabled;
+static int simTxLog[256];
+static int simTxLogSize;
+static uint8_t simCapture[SIM_MAX_PAYLOAD + 40];
+static uint8_t simCaptureSize;
+
+static NWK_DataReq_t simReqs[SIM_MAX_REQUESTS];
+static uint8_t simPayload[SIM_MAX_REQUESTS][SIM_MAX_PAYLOAD];
+static uint32_t simConfTime[SIM_MAX_REQUESTS];
+static int simConfirms, simConfirmsOk, simLastStatus, simAttempts;
+static uint32_t simLastConfTime;
+static int simDuplicates;
+static int simReordered;
+static int simIndPasses, simIndCount;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Medium transmission callback of the nodes, frames are queued and
+         delivered by simDeliver()
+*****************************************************************************/
+static void simMediumTx(void *node, uint8_t *data, uint8_t size)
+{
+  SimNode_t *sender = node;
+  SimPacket_t *packet = &simMedium[simMediumTail++ % SIM_MEDIUM_QUEUE_SIZE];
+
+  sender->lastTxTime = simTime;
+
+  // Data frames of the node 0 carry the request index in the first payload byte
+  if (simTxLogEnabled && 0 == sender->id && size > 60)
+    simTxLog[simTxLogSize++] = data[16];
+
+  // The last data frame of the node 0 is kept for replay
+  if (0 == sender->id && size > 30 && size <= sizeof(simCapture))
+  {
+    memcpy(simCapture, data, size);
+    simCaptureSize = size;
+  }
+
+  packet->from = sender->id;
+  memcpy(packet->data, data, size);
+  packet->size = size;
+}
+
+/*************************************************************************//**
+  @brief Delivers queued frames to all nodes linked to the sender
+*****************************************************************************/
+static void simDeliver(void)
+{
+  while (simMediumHead != simMediumTail)
+  {
+    SimPacket_t *packet = &simMedium[simMediumHead++ % SIM_MEDIUM_QUEUE_SIZE];
+
+    for (int i = 0; i < simNodesAmount; i++)
+    {
+      if (i == packet->from || !simLink[packet->from][i])
+        continue;
+
+      if (simLossPercent && rand() % 100 < simLossPercent)
+        continue;
+
+      simCurrent = i;
+      simNodes[i].rxPass = *simNodes[i].taskPasses;
+      simNodes[i].rx(packet->data, packet->size, SIM_LQI);
+    }
+  }
+}
+
+/*************************************************************************//**
+  @brief Returns symbol @a name of node @a node, exits if it is missing
+*****************************************************************************/
+static void *simSymbol(SimNode_t *node, const char *name)
+{
+  void *symbol = dlsym(node->lib, name);
+
+  if (NULL == symbol)
+  {
+    printf("missing symbol %s\n", name);
+    exit(1);
+  }
+
+  return symbol;
+}
+
+/*************************************************************************//**
+  @brief Copies the node library to @a path, the dynamic loader shares
+         libraries loaded from the same path
+*****************************************************************************/
+static void simCopyLib(const char *path)
+{
+  FILE *in = fopen(simLibPath, "rb");
+  FILE *out = fopen(path, "wb");
+  char buf[4096];
+  size_t size;
+
+  if (NULL == in || NULL == out)
+  {
+    printf("can't copy %s to %s\n", simLibPath, path);
+    exit(1);
+  }
+
+  while ((size = fread(buf, 1, sizeof(buf), in)) > 0)
+    fwrite(buf, 1, size, out);
+
+  fclose(in);
+  fclose(out);
+}
+
+/*************************************************************************//**
+  @brief Replaces the current network with @a amount fully linked nodes, each
+         with its short address equal to its index
+*****************************************************************************/
+static void simLoad(int amount)
+{
+  static int generation;
+
+  for (int i = 0; i < simNodesAmount; i++)
+    dlclose(simNodes[i].lib);
+
+  memset(simNodes, 0, sizeof(simNodes));
+  simMediumHead = simMediumTail = 0;
+  simLossPercent = 0;
+  simNodesAmount = amount;
+  generation++;
+
+  // The nodes share the C library random generator, every test starts from
+  // the same state so that it gives the same result when run alone
+  srand(1);
+
+  for (int i = 0; i < amount; i++)
+  {
+    SimNode_t *node = &simNodes[i];
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/node%d_%d.so", simWorkDir, generation, i);
+    simCopyLib(path);
+    node->lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    remove(path);
+
+    if (NULL == node->lib)
+    {
+      printf("%s\n", dlerror());
+      exit(1);
+    }
+
+    node->id = i;
+    node->init = simSymbol(node, "simNodeInit");
+    node->task = simSymbol(node, "simNodeTask");
+    node->tick = simSymbol(node, "simNodeTick");
+    node->rx = simSymbol(node, "simNodeRx");
+    node->lock = simSymbol(node, "simNodeLock");
+    node->setAddr = simSymbol(node, "NWK_SetAddr");
+    node->setPanId = simSymbol(node, "NWK_SetPanId");
+    node->setRxState = simSymbol(node, "PHY_SetRxState");
+    node->openEndpoint = simSymbol(node, "NWK_OpenEndpoint");
+    node->dataReq = simSymbol(node, "NWK_DataReq");
+    node->stats = simSymbol(node, "NWK_GetStats");
+    node->txCount = simSymbol(node, "simPhyTxCount");
+    node->taskPasses = simSymbol(node, "simTaskPasses");
+    node->promiscuous = simSymbol(node, "simPromiscuous");
+    simTickInterval = *(int *)simSymbol(node, "simTickInterval");
+
+    simCurrent = i;
+    node->init(node, simMediumTx);
+    node->setAddr(i);
+    node->setPanId(SIM_PAN_ID);
+    node->setRxState(true);
+  }
+
+  for (int i = 0; i < amount; i++)
+  {
+    for (int j = 0; j < amount; j++)
+      simLink[i][j] = true;
+  }
+}
+
+/*************************************************************************//**
+  @brief Sets the links of a 4x4 grid, each node hears its 8 neighbours
+*****************************************************************************/
+static void simGrid(void)
+{
+  for (int i = 0; i < simNodesAmount; i++)
+  {
+    for (int j = 0; j < simNodesAmount; j++)
+      simLink[i][j] = abs(i % 4 - j % 4) <= 1 && abs(i / 4 - j / 4) <= 1;
+  }
+}
+
+/*************************************************************************//**
+  @brief Advances the simulation by @a ms milliseconds
+*****************************************************************************/
+static void simStep(int ms)
+{
+  for (int k = 0; k < ms; k++)
+  {
+    simTime++;
+
+    for (int i = 0; i < simNodesAmount; i++)
+    {
+      if (0 == simTime % simTickInterval)
+        simNodes[i].tick();
+
+      for (int pass = 0; pass < SIM_PASSES_PER_MS; pass++)
+      {
+        simCurrent = i;
+        simNodes[i].task();
+        simDeliver();
+      }
+    }
+  }
+}
+
+/*************************************************************************//**
+  @brief Data indication handler of the simulated application
+*****************************************************************************/
+static bool simDataInd(NWK_DataInd_t *ind)
+{
+  SimNode_t *node = &simNodes[simCurrent];
+
+  simIndPasses += *node->taskPasses - node->rxPass;
+  simIndCount++;
+
+  // The first payload byte is the request index, see simSend()
+  if (ind->size && ind->data[0] < 64)
+  {
+    uint64_t bit = 1ull << ind->data[0];
+
+    if (node->seen & bit)
+      simDuplicates++;
+
+    if (ind->data[0] < node->lastIndex)
+      simReordered++;
+
+    node->seen |= bit;
+    node->lastIndex = ind->data[0];
+  }
+
+  node->received++;
+  node->receivedBytes += ind->size;
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Data request confirmation handler of the simulated application
+*****************************************************************************/
+static void simDataConf(NWK_DataReq_t *req)
+{
+  simConfTime[req - simReqs] = simTime;
+  simLastConfTime = simTime;
+  simLastStatus = req->status;
+  simAttempts += req->attempts;
+  simConfirms++;
+
+  if (NWK_SUCCESS_STATUS == req->status)
+    simConfirmsOk++;
+}
+
+/*************************************************************************//**
+  @brief Sends request number @a index of @a size bytes from node @a from
+         to address @a to
+*****************************************************************************/
+static void simSend(int from, int to, int index, uint8_t options, uint8_t size)
+{
+  NWK_DataReq_t *req = &simReqs[index];
+
+  memset(req, 0, sizeof(NWK_DataReq_t));
+  req->dstAddr = to;
+  req->dstEndpoint = SIM_ENDPOINT;
+  req->srcEndpoint = SIM_ENDPOINT;
+  req->options = options;
+  req->data = simPayload[index];
+  req->size = size;
+  req->confirm = simDataConf;
+
+  for (int i = 0; i < size; i++)
+    simPayload[index][i] = i + index;
+
+  simCurrent = from;
+  simNodes[from].dataReq(req);
+}
+
+/*************************************************************************//**
+  @brief Loads @a amount nodes with the default endpoint open and clears the
+         counters
+*****************************************************************************/
+static void simStart(int amount)
+{
+  simLoad(amount);
+
+  for (int i = 0; i < amount; i++)
+    simNodes[i].openEndpoint(SIM_ENDPOINT, simDataInd);
+
+  simConfirms = simConfirmsOk = simAttempts = simDuplicates = simReordered = 0;
+}
+
+/*************************************************************************//**
+  @brief Clears the delivery and confirmation counters
+*****************************************************************************/
+static void simReset(void)
+{
+  for (int i = 0; i < simNodesAmount; i++)
+  {
+    simNodes[i].received = simNodes[i].receivedBytes = 0;
+    simNodes[i].seen = 0;
+    simNodes[i].lastIndex = 0;
+  }
+
+  simConfirms = simConfirmsOk = simAttempts = simDuplicates = simReordered = 0;
+}
+
+/*************************************************************************//**
+  @brief Checks that no node holds NWK resources any more
+*****************************************************************************/
+static void simCheckIdle(void)
+{
+  for (int i = 0; i < simNodesAmount; i++)
+  {
+    if (simNodes[i].lock())
+    {
+      printf("FAIL node %d is not idle, lock %u\n", i, simNodes[i].lock());
+      simFailures++;
+    }
+  }
+}
+
+/*************************************************************************//**
+  @brief Acknowledged unicast frame to a neighbour
+*****************************************************************************/
+static void testUnicast(void)
+{
+  simStart(2);
+  simSend(0, 1, 0, NWK_OPT_ACK_REQUEST, 20);
+  simStep(1500);
+  SIM_CHECK(simConfirms == 1 && simConfirmsOk == 1);
+  SIM_CHECK(simNodes[1].received == 1);
+  simStep(200);
+  simCheckIdle();
+}
+
+/*************************************************************************//**
+  @brief Unicast frame to a node that does not receive is confirmed with an error
+*****************************************************************************/
+static void testNoAck(void)
+{
+  simStart(2);
+  simNodes[1].setRxState(false);
+  simSend(0, 1, 0, NWK_OPT_ACK_REQUEST, 20);
+  simStep(500);
+  SIM_CHECK(simConfirms == 0);
+  simStep(30000);
+  SIM_CHECK(simConfirms == 1 && simLastStatus != NWK_SUCCESS_STATUS);
+  simCheckIdle();
+}
+
+/*************************************************************************//**
+  @brief Burst of acknowledged frames to one neighbour
+*****************************************************************************/
+static void testBurst(void)
+{
+  simStart(2);
+
+  for (int i = 0; i < 20; i++)
+    simSend(0, 1, i, NWK_OPT_ACK_REQUEST, 50);
+
+  simStep(2000);
+  SIM_CHECK(simConfirms == 20 && simConfirmsOk == 20);
+  SIM_CHECK(simNodes[1].received == 20);
+  simStep(500);
+  simCheckIdle();
+}
+
+/*************************************************************************//**
+  @brief Route over an intermediate node, with and without a known route
+*****************************************************************************/
+static void testMultihop(void)
+{
+  simStart(3);
+  simLink[0][2] = simLink[2][0] = false;
+
+  for (int i = 0; i < 2; i++)
+  {
+    simReset();
+    simSend(0, 2, i, NWK_OPT_ACK_REQUEST, 30);
+    simStep(1500);
+    SIM_CHECK(simConfirms == 1 && simConfirmsOk == 1);
+    SIM_CHECK(simNodes[2].received == 1 && simNodes[1].received == 0);
+  }
+
+  simStep(500);
+  simCheckIdle();
+}
+
+/*************************************************************************//**
+  @brief Broadcast frame reaches all nodes
+*****************************************************************************/
+static void testBroadcast(void)
+{
+  simStart(4);
+  simSend(0, 0xffff, 0, 0, 10);
+  simStep(1500);
+  SIM_CHECK(simConfirms == 1 && simConfirmsOk == 1);
+
+  for (int i = 1; i < 4; i++)
+    SIM_CHECK(simNodes[i].received == 1);
+
+  simStep(500);
+  simCheckIdle();
+}
+
+/*************************************************************************//**
+  @brief Acknowledged frames over lossy links, one and two hops
+*****************************************************************************/
+static void testLossy(void)
+{
+  simStart(3);
+  simLink[0][2] = simLink[2][0] = false;
+  simLossPercent = 15;
+  srand(7);
+
+  for (int round = 0; round < 4; round++)
+  {
+    for (int i = 0; i < 10; i++)
+      simSend(0, (i & 1) ? 2 : 1, round * 10 + i, NWK_OPT_ACK_REQUEST, 30);
+
+    simStep(6000 * (NWK_ACK_RETRIES + 1));
+  }
+
+  SIM_CHECK(simConfirms == 40);
+  printf("lossy: %d/40 ok, rx1 %d rx2 %d\n", simConfirmsOk,
+      simNodes[1].received, simNodes[2].received);
+  simLossPercent = 0;
+  simStep(3000);
+  simCheckIdle();
+}
+
+/*************************************************************************//**
+  @brief Secured frames are delivered when both nodes have the same key
+*****************************************************************************/
+static void testSecurity(void)
+{
+#ifdef NWK_ENABLE_SECURITY
+  simStart(2);
+
+  for (int i = 0; i < 2; i++)
+  {
+    void (*setKey)(uint8_t *key) = simSymbol(&simNodes[i], "NWK_SetSecurityKey");
+    setKey((uint8_t *)"0123456789abcdef");
+  }
+
+  for (int i = 0; i < 5; i++)
+    simSend(0, 1, i, NWK_OPT_ACK_REQUEST | NWK_OPT_ENABLE_SECURITY, 40 + i);
+
+  simStep(2000);
+  SIM_CHECK(simConfirms == 5 && simConfirmsOk == 5);
+  SIM_CHECK(simNodes[1].received == 5);
+#endif
+}
+
+#ifdef NWK_ENABLE_SECURITY
+/*************************************************************************//**
+  @brief Delivers the captured frame to the node 1 with the attempt number
+         @a attempt, a non-zero @a corrupt damages the MIC
+  @return Number of frames the node 1 sent in response
+*****************************************************************************/
+static int simReplay(uint8_t attempt, bool corrupt)
+{
+  uint8_t frame[sizeof(simCapture)];
+  int sent = *simNodes[1].txCount;
+
+  // The attempt number is in bits 5 and 6 of the NWK frame control field
+  memcpy(frame, simCapture, simCaptureSize);
+  frame[9] = (frame[9] & ~0x60) | (attempt << 5);
+
+  if (corrupt)
+    frame[simCaptureSize - 3] ^= 0xff;
+
+  simCurrent = 1;
+  simNodes[1].rx(frame, simCaptureSize, SIM_LQI);
+  simStep(100);
+
+  return *simNodes[1].txCount - sent;
+}
+#endif
+
+/*************************************************************************//**
+  @brief Secured frames replayed with a higher attempt number are not
+         delivered again, and only a verified one is acknowledged again
+*****************************************************************************/
+static void testReplay(void)
+{
+#ifdef NWK_ENABLE_SECURITY
+  simStart(2);
+
+  for (int i = 0; i < 2; i++)
+  {
+    void (*setKey)(uint8_t *key) = simSymbol(&simNodes[i], "NWK_SetSecurityKey");
+    setKey((uint8_t *)"0123456789abcdef");
+  }
+
+  simSend(0, 1, 0, NWK_OPT_ENABLE_SECURITY, 40);
+  simStep(100);
+  SIM_CHECK(simNodes[1].received == 1);
+  SIM_CHECK(0 == simReplay(1, false));
+  SIM_CHECK(simNodes[1].received == 1 && simDuplicates == 0);
+
+  simSend(0, 1, 1, NWK_OPT_ACK_REQUEST | NWK_OPT_ENABLE_SECURITY, 40);
+  simStep(100);
+  SIM_CHECK(simConfirmsOk == 2 && simNodes[1].received == 2);
+  SIM_CHECK(0 == simReplay(1, true));
+  SIM_CHECK(1 == simReplay(2, false));
+  SIM_CHECK(simNodes[1].received == 2 && simDuplicates == 0);
+  simStep(200);
+  simCheckIdle();
+#endif
+}
+
+/*************************************************************************//**
+  @brief Unicast frame gets through a broadcast storm
+*****************************************************************************/
+static void testStorm(void)
+{
+  NWK_Stats_t *stats;
+
+  // Two nodes flood broadcasts while a unicast frame has to get through
+  simStart(4);
+
+  for (int i = 0; i < 25; i++)
+  {
+    simSend(2, 0xffff, i, 0, 100);
+    simSend(3, 0xffff, 25 + i, 0, 100);
+  }
+
+  simSend(0, 1, 60, NWK_OPT_ACK_REQUEST, 20);
+  simStep(3000);
+  SIM_CHECK(simConfirms == 51);
+  SIM_CHECK(simReqs[60].status == NWK_SUCCESS_STATUS);
+
+  stats = simNodes[1].stats();
+  printf("storm: node 1 allocation failures rx %u rebroadcast %u data %u control %u\n",
+      stats->allocFailures[NWK_BUFFER_CLASS_RX], stats->allocFailures[NWK_BUFFER_CLASS_REBROADCAST],
+      stats->allocFailures[NWK_BUFFER_CLASS_DATA], stats->allocFailures[NWK_BUFFER_CLASS_CONTROL]);
+}
+
+/*************************************************************************//**
+  @brief Broadcast flooding in a full mesh and in a grid
+*****************************************************************************/
+static void testDense(void)
+{
+  for (int grid = 0; grid < 2; grid++)
+  {
+    int sent = 0, delivered = 0;
+
+    simStart(16);
+
+    if (grid)
+      simGrid();
+
+    for (int i = 0; i < 16; i++)
+      sent -= *simNodes[i].txCount;
+
+    for (int i = 0; i < 10; i++)
+    {
+      simSend(0, 0xffff, i, 0, 40);
+      simStep(1000);
+    }
+
+    for (int i = 0; i < 16; i++)
+      sent += *simNodes[i].txCount;
+
+    for (int i = 1; i < 16; i++)
+      delivered += simNodes[i].received;
+
+    printf("dense %s: 10 broadcasts, %d frames sent, %d/150 delivered",
+        grid ? "grid" : "mesh", sent, delivered);
+
+#ifdef NWK_ENABLE_BROADCAST_SUPPRESSION
+    {
+      int relayed = 0, suppressed = 0;
+
+      for (int i = 0; i < 16; i++)
+      {
+        relayed += simNodes[i].stats()->broadcastsRelayed;
+        suppressed += simNodes[i].stats()->broadcastsSuppressed;
+      }
+
+      printf(", relayed %d suppressed %d", relayed, suppressed);
+    }
+#endif
+
+    printf("\n");
+    SIM_CHECK(delivered == 150);
+  }
+}
+
+/*************************************************************************//**
+  @brief Comparison function for qsort() of times
+*****************************************************************************/
+static int simCompareTime(const void *a, const void *b)
+{
+  return *(const uint32_t *)a - *(const uint32_t *)b;
+}
+
+/*************************************************************************//**
+  @brief Per-destination order and latency of a burst of requests
+*****************************************************************************/
+static void testFifo(void)
+{
+  uint32_t latency[40], start, lastSmall = 0;
+  int last[4] = { -1, -1, -1, -1 };
+  bool inOrder = true;
+
+  // 40 requests, 30 to destination 1 and then 5 each to destinations 2 and 3
+  simStart(4);
+  simTxLogEnabled = true;
+  simTxLogSize = 0;
+  start = simTime;
+
+  for (int i = 0; i < 40; i++)
+    simSend(0, i < 30 ? 1 : 2 + (i & 1), i, NWK_OPT_ACK_REQUEST | NWK_OPT_LINK_LOCAL, 62);
+
+  simStep(5000);
+  simTxLogEnabled = false;
+
+#ifndef NWK_ENABLE_ROUTE_DISCOVERY // ACKs wait for the discovery of the route back
+  SIM_CHECK(simConfirms == 40 && simConfirmsOk == 40);
+#endif
+
+  for (int i = 0; i < simTxLogSize; i++)
+  {
+    int index = simTxLog[i];
+    int dst = simReqs[index].dstAddr;
+
+    if (index < last[dst])
+      inOrder = false;
+
+    last[dst] = index;
+  }
+
+  for (int i = 0; i < 40; i++)
+  {
+    latency[i] = simConfTime[i] - start;
+
+    if (i >= 30 && latency[i] > lastSmall)
+      lastSmall = latency[i];
+  }
+
+  qsort(latency, 40, sizeof(latency[0]), simCompareTime);
+
+  printf("fifo: burst of 40, latency p50 %u p90 %u max %u ms, dst 2/3 done after %u ms, "
+      "%d sent, per-destination order %s\n", latency[20], latency[36], latency[39],
+      lastSmall, simTxLogSize, inOrder ? "kept" : "reversed");
+  SIM_CHECK(inOrder);
+}
+
+/*************************************************************************//**
+  @brief More sources than duplicate rejection table entries
+*****************************************************************************/
+static void testDuplicateSources(void)
+{
+  // 15 sources for a 10 entry duplicate rejection table
+  simStart(16);
+
+  for (int round = 0; round < 4; round++)
+  {
+    for (int i = 1; i < 16; i++)
+    {
+      simSend(i, 0, i, NWK_OPT_LINK_LOCAL, 20);
+      simStep(5);
+    }
+
+    simStep(100);
+  }
+
+  printf("dupsources: 15 sources, %d/60 frames indicated\n", simNodes[0].received);
+  SIM_CHECK(simNodes[0].received == 60);
+}
+
+/*************************************************************************//**
+  @brief Broadcast copies arriving over several paths are indicated once
+*****************************************************************************/
+static void testMultipath(void)
+{
+  int delivered = 0, rejected = 0;
+
+  // A burst of broadcasts flooded over a grid, late copies arrive over longer paths
+  simStart(16);
+  simGrid();
+
+  for (int i = 0; i < 40; i++)
+  {
+    simSend(0, 0xffff, i, 0, 20);
+    simStep(2);
+  }
+
+  simStep(2000);
+
+  for (int i = 1; i < 16; i++)
+    delivered += __builtin_popcountll(simNodes[i].seen);
+
+  for (int i = 0; i < 16; i++)
+    rejected += simNodes[i].stats()->duplicatesRejected;
+
+  printf("multipath: 40 broadcasts, %d/600 delivered, %d duplicate deliveries, "
+      "%d duplicates rejected\n", delivered, simDuplicates, rejected);
+  SIM_CHECK(simDuplicates == 0);
+}
+
+/*************************************************************************//**
+  @brief Frames of a foreign PAN do not crowd out own frames when the address
+         filter of the transceiver is off
+*****************************************************************************/
+static void testForeignPan(void)
+{
+  NWK_Stats_t *stats;
+
+  // Nodes 4 to 7 form another PAN on the same channel and flood it
+  simStart(8);
+  *simNodes[0].promiscuous = true;
+
+  for (int i = 4; i < 8; i++)
+    simNodes[i].setPanId(0x4321);
+
+  for (int round = 0; round < 10; round++)
+  {
+    for (int i = 4; i < 8; i++)
+      simSend(i, 0xffff, 4 * round + i - 4, 0, 80);
+
+    // Node 0 also hears unicast frames between other nodes and the
+    // rebroadcasts of its own broadcasts
+    simSend(1, 0, 40 + round, NWK_OPT_ACK_REQUEST | NWK_OPT_LINK_LOCAL, 40);
+    simSend(2, 3, 50 + round, NWK_OPT_LINK_LOCAL, 40);
+
+    if (round < 4)
+      simSend(0, 0xffff, 60 + round, 0, 20);
+    simStep(20);
+  }
+
+  simStep(2000);
+  *simNodes[0].promiscuous = false;
+
+  stats = simNodes[0].stats();
+  printf("foreignpan: node 0 got %d/10 own PAN frames, rx allocation failures %u, "
+      "dropped invalid %u foreign PAN %u own %u not for us %u\n",
+      simNodes[0].received, stats->allocFailures[NWK_BUFFER_CLASS_RX],
+      stats->rxDropped[NWK_RX_DROP_INVALID], stats->rxDropped[NWK_RX_DROP_FOREIGN_PAN],
+      stats->rxDropped[NWK_RX_DROP_OWN_FRAME], stats->rxDropped[NWK_RX_DROP_NOT_FOR_US]);
+  SIM_CHECK(simNodes[0].received == 10);
+  SIM_CHECK(stats->rxDropped[NWK_RX_DROP_FOREIGN_PAN] >= 40);
+  SIM_CHECK(stats->rxDropped[NWK_RX_DROP_OWN_FRAME] >= 4);
+  SIM_CHECK(stats->rxDropped[NWK_RX_DROP_NOT_FOR_US] >= 10);
+  SIM_CHECK(stats->rxDropped[NWK_RX_DROP_INVALID] == 0);
+  SIM_CHECK(stats->allocFailures[NWK_BUFFER_CLASS_RX] == 0);
+}
+
+/*************************************************************************//**
+  @brief Main loop passes from reception to the indication and to the buffer
+         release
+*****************************************************************************/
+static void testRxLatency(void)
+{
+  int release = 0;
+
+  simStart(2);
+  simIndPasses = simIndCount = 0;
+
+  for (int i = 0; i < 20; i++)
+  {
+    uint16_t lock;
+    int passes;
+
+    // Run the sender until its frame is on the medium and confirmed
+    simSend(1, 0, i, NWK_OPT_LINK_LOCAL, 30);
+
+    while (simNodes[1].lock() || simMediumHead == simMediumTail)
+    {
+      simCurrent = 1;
+      simNodes[1].task();
+    }
+
+    lock = simNodes[0].lock();
+    simDeliver();
+    passes = *simNodes[0].taskPasses;
+
+    for (int guard = 0; simNodes[0].lock() > lock && guard < 100; guard++)
+    {
+      simCurrent = 0;
+      simNodes[0].task();
+    }
+
+    release += *simNodes[0].taskPasses - passes;
+    simStep(20);
+  }
+
+  printf("rxlatency: %d frames, %.1f passes to indication, %.1f passes to buffer release\n",
+      simIndCount, (double)simIndPasses / simIndCount, (double)release / 20);
+  SIM_CHECK(simNodes[0].received == 20);
+}
+
+#ifdef NWK_ENABLE_AGGREGATION
+static int simRejectIndex;
+
+/*************************************************************************//**
+  @brief Data indication handler that rejects the message simRejectIndex once
+*****************************************************************************/
+static bool simRejectOnceInd(NWK_DataInd_t *ind)
+{
+  if (ind->size && ind->data[0] == simRejectIndex)
+  {
+    simRejectIndex = -1;
+    return false;
+  }
+
+  return simDataInd(ind);
+}
+#endif
+
+/*************************************************************************//**
+  @brief Small messages to the same destination share frames
+*****************************************************************************/
+static void testAggregate(void)
+{
+#ifdef NWK_ENABLE_AGGREGATION
+  uint32_t start;
+  int sent;
+
+  simStart(2);
+  sent = *simNodes[0].txCount;
+
+  for (int i = 0; i < 8; i++)
+    simSend(0, 1, i, NWK_OPT_ACK_REQUEST | NWK_OPT_AGGREGATE, 8);
+
+  simStep(1500);
+  SIM_CHECK(simConfirms == 8 && simConfirmsOk == 8);
+  SIM_CHECK(simNodes[1].received == 8 && simNodes[1].receivedBytes == 64);
+  printf("aggregate: 8 messages in %d frames\n", *simNodes[0].txCount - sent);
+
+  simReset();
+  simSend(0, 1, 20, NWK_OPT_ACK_REQUEST | NWK_OPT_AGGREGATE, 100);
+  simSend(0, 1, 21, NWK_OPT_ACK_REQUEST | NWK_OPT_AGGREGATE, 30);
+  simStep(1500);
+  SIM_CHECK(simConfirms == 2 && simConfirmsOk == 2 && simNodes[1].receivedBytes == 130);
+
+  // A regular message does not overtake aggregated ones to the same destination
+  simReset();
+
+  for (int i = 0; i < 3; i++)
+    simSend(0, 1, i, NWK_OPT_ACK_REQUEST | NWK_OPT_AGGREGATE, 8);
+
+  simStep(2);
+  simSend(0, 1, 3, NWK_OPT_ACK_REQUEST, 8);
+  simStep(1500);
+  SIM_CHECK(simConfirms == 4 && simConfirmsOk == 4 && simNodes[1].received == 4);
+  SIM_CHECK(simReordered == 0);
+
+  // A single message is held for NWK_AGGREGATION_TIMEOUT within one timer tick
+  simStep(200);
+  simReset();
+  simNodes[0].lastTxTime = 0;
+  start = simTime;
+  simSend(0, 1, 0, NWK_OPT_ACK_REQUEST | NWK_OPT_AGGREGATE, 8);
+  simStep(NWK_AGGREGATION_TIMEOUT * 2);
+  printf("aggregate: single message held for %u ms\n", simNodes[0].lastTxTime - start);
+  SIM_CHECK(abs((int)(simNodes[0].lastTxTime - start) - NWK_AGGREGATION_TIMEOUT) < simTickInterval);
+
+  // Messages accepted before one was rejected are not indicated again on retry
+  simStep(200);
+  simNodes[1].openEndpoint(SIM_ENDPOINT, simRejectOnceInd);
+  simReset();
+  simRejectIndex = 1;
+
+  for (int i = 0; i < 3; i++)
+    simSend(0, 1, i, NWK_OPT_ACK_REQUEST | NWK_OPT_AGGREGATE, 8);
+
+  simStep(3000 * (NWK_ACK_RETRIES + 1));
+  SIM_CHECK(simConfirms == 3 && simNodes[1].received == 2 + (NWK_ACK_RETRIES > 0));
+  SIM_CHECK(simConfirmsOk == (NWK_ACK_RETRIES > 0 ? 3 : 0) && simDuplicates == 0);
+  simNodes[1].openEndpoint(SIM_ENDPOINT, simDataInd);
+  simStep(200);
+  simCheckIdle();
+#endif
+}
+
+#ifdef NWK_ENABLE_FRAGMENTATION
+#define SIM_FRAG_SIZE (NWK_FRAG_RX_BUFFER_SIZE < 5000 ? NWK_FRAG_RX_BUFFER_SIZE : 5000)
+
+static uint8_t simFragData[SIM_FRAG_SIZE];
+static NWK_FragReq_t simFragReq;
+static int simFragReceived, simFragConfirms;
+
+/*************************************************************************//**
+  @brief Fragmented data indication handler
+*****************************************************************************/
+static void simFragInd(NWK_FragInd_t *ind)
+{
+  if (ind->size == sizeof(simFragData) && 2 == ind->dstEndpoint &&
+      0 == memcmp(ind->data, simFragData, sizeof(simFragData)))
+    simFragReceived++;
+}
+
+/*************************************************************************//**
+  @brief Fragmented data request confirmation handler
+*****************************************************************************/
+static void simFragConf(NWK_FragReq_t *req)
+{
+  (void)req;
+  simFragConfirms++;
+}
+#endif
+
+/*************************************************************************//**
+  @brief Fragmented transfer with and without loss, and one too large for the receiver
+*****************************************************************************/
+static void testFrag(void)
+{
+#ifdef NWK_ENABLE_FRAGMENTATION
+  for (int loss = 0; loss <= 20; loss += 20)
+  {
+    void (*fragReq)(NWK_FragReq_t *req);
+    void (*openEndpoint)(uint8_t id, void (*handler)(NWK_FragInd_t *ind));
+
+    simStart(2);
+    fragReq = simSymbol(&simNodes[0], "NWK_FragReq");
+    openEndpoint = simSymbol(&simNodes[1], "NWK_FragOpenEndpoint");
+
+    for (int i = 0; i < (int)sizeof(simFragData); i++)
+      simFragData[i] = i * 7 + (i >> 8);
+
+    simCurrent = 1;
+    openEndpoint(2, simFragInd);
+
+    simFragReceived = simFragConfirms = 0;
+    simLossPercent = loss;
+    srand(3);
+
+    memset(&simFragReq, 0, sizeof(simFragReq));
+    simFragReq.dstAddr = 1;
+    simFragReq.dstEndpoint = 2;
+    simFragReq.srcEndpoint = 2;
+    simFragReq.data = simFragData;
+    simFragReq.size = sizeof(simFragData);
+    simFragReq.confirm = simFragConf;
+    simCurrent = 0;
+    fragReq(&simFragReq);
+    simStep(20000);
+
+    SIM_CHECK(simFragConfirms == 1 && simFragReq.status == NWK_SUCCESS_STATUS && simFragReceived == 1);
+    printf("frag loss %d%%: %u bytes, %u fragments sent, %u ms\n", loss,
+        (unsigned)sizeof(simFragData), simFragReq.sent, (unsigned)simFragReq.time);
+    simLossPercent = 0;
+
+    // Too large for the receiver
+    simFragReceived = simFragConfirms = 0;
+    simFragReq.size = 2000;
+    simFragReq.dstEndpoint = 3;
+    simCurrent = 0;
+    fragReq(&simFragReq);
+    simStep(3000);
+    SIM_CHECK(simFragConfirms == 1 && simFragReq.status != NWK_SUCCESS_STATUS && simFragReceived == 0);
+    simStep(4000);
+    simCheckIdle();
+  }
+#endif
+}
+
+/*************************************************************************//**
+  @brief Block acknowledgements on one and two hops and with loss
+*****************************************************************************/
+static void testBlockAck(void)
+{
+#ifdef NWK_ENABLE_BLOCK_ACK
+  int sent;
+
+  simStart(2);
+  sent = *simNodes[1].txCount;
+
+  for (int i = 0; i < 20; i++)
+    simSend(0, 1, i, NWK_OPT_ACK_REQUEST, 40);
+
+  simStep(1500);
+  SIM_CHECK(simConfirms == 20 && simConfirmsOk == 20 && simNodes[1].received == 20);
+  printf("blockack: 20 frames acknowledged with %d frames\n", *simNodes[1].txCount - sent);
+  simStep(500);
+  simCheckIdle();
+
+  simStart(3);
+  simLink[0][2] = simLink[2][0] = false;
+
+  for (int i = 0; i < 12; i++)
+    simSend(0, 2, i, NWK_OPT_ACK_REQUEST, 40);
+
+  simStep(3000);
+  SIM_CHECK(simConfirms == 12 && simConfirmsOk == 12 && simNodes[2].received == 12);
+  simStep(500);
+  simCheckIdle();
+
+  simStart(2);
+  simLossPercent = 20;
+  srand(5);
+
+  for (int i = 0; i < 20; i++)
+    simSend(0, 1, i, NWK_OPT_ACK_REQUEST, 40);
+
+  simStep(8000 * (NWK_ACK_RETRIES + 1));
+  simLossPercent = 0;
+  SIM_CHECK(simConfirms == 20);
+  printf("blockack lossy: %d/20 ok, rx %d\n", simConfirmsOk, simNodes[1].received);
+  simStep(2000);
+  simCheckIdle();
+#endif
+}
+
+/*************************************************************************//**
+  @brief Time from a lost frame to its failure after the RTT has been learned
+*****************************************************************************/
+static void testRto(void)
+{
+  // Time from a lost frame to NWK_NO_ACK_STATUS after the RTT has been learned
+  simStart(3);
+  simLink[0][2] = simLink[2][0] = false;
+
+  for (int dst = 1; dst <= 2; dst++)
+  {
+    uint32_t start;
+
+    for (int i = 0; i < 10; i++)
+    {
+      simSend(0, dst, i, NWK_OPT_ACK_REQUEST, 40);
+      simStep(200);
+    }
+
+    SIM_CHECK(simConfirmsOk == simConfirms);
+    simReset();
+
+    simNodes[dst].setRxState(false);
+    start = simTime;
+    simSend(0, dst, 20, NWK_OPT_ACK_REQUEST, 40);
+    simStep(3000 * (NWK_ACK_RETRIES + 1));
+    SIM_CHECK(simConfirms == 1 && simLastStatus == NWK_NO_ACK_STATUS);
+    printf("rto: %d hop(s), lost frame reported after %u ms (%d attempts)\n",
+        dst, simLastConfTime - start, simReqs[20].attempts);
+    simNodes[dst].setRxState(true);
+    simReset();
+  }
+}
+
+/*************************************************************************//**
+  @brief NWK retransmissions over lossy links, no frame indicated twice
+*****************************************************************************/
+static void testRetry(void)
+{
+  // Lossy links with NWK retries, no frame may be indicated twice
+  for (int hops = 1; hops <= 2; hops++)
+  {
+    simStart(3);
+    simLink[0][2] = simLink[2][0] = false;
+
+    if (2 == hops)
+    {
+      simSend(0, 2, 0, NWK_OPT_ACK_REQUEST, 10);
+      simStep(3000);
+      simReset();
+    }
+
+    simLossPercent = 20;
+    srand(11);
+
+    for (int i = 0; i < 40; i++)
+    {
+      simSend(0, hops, i % 10, NWK_OPT_ACK_REQUEST, 30);
+      simStep(i % 10 == 9 ? 12000 : 10);
+    }
+
+    simLossPercent = 0;
+    SIM_CHECK(simConfirms == 40);
+    SIM_CHECK(simNodes[hops].received <= 40);
+    printf("retry: %d hop(s), 20%% loss: %d/40 ok, %d delivered, %d attempts\n",
+        hops, simConfirmsOk, simNodes[hops].received, simAttempts);
+    simStep(3000);
+    simCheckIdle();
+  }
+}
+
+static void (*simDefer)(NWK_DataInd_t *ind);
+static void (*simRelease)(NWK_DataInd_t *ind);
+static NWK_DataInd_t simDeferred[16];
+static int simDeferredAmount;
+
+/*************************************************************************//**
+  @brief Data indication handler that keeps the frame for later release
+*****************************************************************************/
+static bool simDeferInd(NWK_DataInd_t *ind)
+{
+  simDataInd(ind);
+  simDeferred[simDeferredAmount++] = *ind;
+  simDefer(ind);
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Deferred indications keep their payload and buffers until released
+*****************************************************************************/
+static void testDeferred(void)
+{
+  simLoad(2);
+  simDefer = simSymbol(&simNodes[0], "NWK_DataIndDefer");
+  simRelease = simSymbol(&simNodes[0], "NWK_DataIndRelease");
+  simNodes[0].openEndpoint(SIM_ENDPOINT, simDeferInd);
+  simNodes[1].openEndpoint(SIM_ENDPOINT, simDataInd);
+  simReset();
+  simDeferredAmount = 0;
+
+  for (int i = 0; i < 5; i++)
+    simSend(1, 0, i, NWK_OPT_ACK_REQUEST | NWK_OPT_LINK_LOCAL, 40);
+
+  simStep(3000);
+  SIM_CHECK(simConfirms == 5 && simConfirmsOk == 5 && simDeferredAmount == 5);
+  SIM_CHECK(simNodes[0].lock() == 5);
+
+  // More traffic arrives while the first frames are held
+  for (int i = 5; i < 10; i++)
+    simSend(1, 0, i, NWK_OPT_ACK_REQUEST | NWK_OPT_LINK_LOCAL, 40);
+
+  simStep(3000);
+  SIM_CHECK(simConfirms == 10 && simConfirmsOk == 10 && simDeferredAmount == 10);
+  SIM_CHECK(simNodes[0].lock() == 10);
+
+  for (int i = 0; i < 10; i++)
+  {
+    NWK_DataInd_t *ind = &simDeferred[i];
+
+    SIM_CHECK(ind->size == 40 && 0 == memcmp(ind->data, simPayload[ind->data[0]], 40));
+    simRelease(ind);
+  }
+
+  SIM_CHECK(simNodes[0].lock() == 0);
+
+  // A second release is ignored
+  simRelease(&simDeferred[0]);
+  SIM_CHECK(simNodes[0].lock() == 0);
+  printf("deferred: %d frames held and released\n", simDeferredAmount);
+}
+
+static NWK_DataInd_t simSlowQueue[128];
+static unsigned simSlowHead, simSlowTail;
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+static int simCongestionEvents[2];
+
+/*************************************************************************//**
+  @brief Congestion state change handler
+*****************************************************************************/
+static void simCongestionInd(bool congested)
+{
+  simCongestionEvents[congested]++;
+}
+#endif
+
+/*************************************************************************//**
+  @brief Data indication handler of a slow consumer, frames are released
+         later by the test
+*****************************************************************************/
+static bool simSlowInd(NWK_DataInd_t *ind)
+{
+  simDataInd(ind);
+  simSlowQueue[simSlowTail++ % 128] = *ind;
+  simDefer(ind);
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Burst of acknowledged frames to a consumer that keeps every frame
+         and releases one per 10 ms
+*****************************************************************************/
+static void testCongestion(void)
+{
+  NWK_Stats_t *stats;
+  uint32_t start;
+  int noAck = 0;
+
+  simLoad(2);
+  simDefer = simSymbol(&simNodes[0], "NWK_DataIndDefer");
+  simRelease = simSymbol(&simNodes[0], "NWK_DataIndRelease");
+  simNodes[0].openEndpoint(SIM_ENDPOINT, simSlowInd);
+  simNodes[1].openEndpoint(SIM_ENDPOINT, simDataInd);
+  simReset();
+  simSlowHead = simSlowTail = 0;
+
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  simCongestionEvents[0] = simCongestionEvents[1] = 0;
+
+  {
+    void (*setHandler)(void (*handler)(bool congested)) =
+        simSymbol(&simNodes[0], "NWK_SetCongestionHandler");
+    setHandler(simCongestionInd);
+  }
+#endif
+
+  start = simTime;
+
+  for (int i = 0; i < 60; i++)
+    simSend(1, 0, i, NWK_OPT_ACK_REQUEST | NWK_OPT_LINK_LOCAL, 40);
+
+  while (simConfirms < 60 && simTime - start < 60000)
+  {
+    simStep(10);
+
+    if (simSlowHead != simSlowTail)
+      simRelease(&simSlowQueue[simSlowHead++ % 128]);
+  }
+
+  for (int i = 0; i < 60; i++)
+  {
+    if (NWK_NO_ACK_STATUS == simReqs[i].status)
+      noAck++;
+  }
+
+  while (simSlowHead != simSlowTail)
+    simRelease(&simSlowQueue[simSlowHead++ % 128]);
+
+  simStep(100);
+
+  stats = simNodes[0].stats();
+  printf("congestion: %d/60 ok, %d no ack, %d delivered, %d rx overflows, %u ms",
+      simConfirmsOk, noAck, simNodes[0].received,
+      stats->rxDropped[NWK_RX_DROP_NO_BUFFER], simTime - start);
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  printf(", congested %d times, %d backoffs", simCongestionEvents[1],
+      simNodes[1].stats()->congestionBackoffs);
+#endif
+  printf("\n");
+
+  SIM_CHECK(simConfirms == 60);
+  simCheckIdle();
+#ifdef NWK_ENABLE_CONGESTION_CONTROL
+  SIM_CHECK(simCongestionEvents[1] > 0 && simCongestionEvents[1] == simCongestionEvents[0]);
+#endif
+}
+
+/*************************************************************************//**
+  @brief Route table lookups agree with a linear scan of the table after
+         random updates, removals and direct writes to the table
+*****************************************************************************/
+static void testRouteIndex(void)
+{
+#ifdef NWK_ENABLE_ROUTING
+  NWK_RouteTableEntry_t *(*findEntry)(uint16_t dst, uint8_t multicast);
+  NWK_RouteTableEntry_t *(*newEntry)(void);
+  NWK_RouteTableEntry_t *(*routeTable)(void);
+  void (*updateEntry)(uint16_t dst, uint8_t multicast, uint16_t nextHop, uint8_t lqi);
+  void (*removeRoute)(uint16_t dst, uint8_t multicast);
+  NWK_RouteTableEntry_t *table;
+  int wrong = 0, found = 0;
+
+  simLoad(1);
+  findEntry = simSymbol(&simNodes[0], "NWK_RouteFindEntry");
+  newEntry = simSymbol(&simNodes[0], "NWK_RouteNewEntry");
+  routeTable = simSymbol(&simNodes[0], "NWK_RouteTable");
+  updateEntry = simSymbol(&simNodes[0], "nwkRouteUpdateEntry");
+  removeRoute = simSymbol(&simNodes[0], "nwkRouteRemove");
+  table = routeTable();
+  srand(7);
+
+  for (int n = 0; n < 200000; n++)
+  {
+    NWK_RouteTableEntry_t *entry, *expected = NULL;
+    uint16_t dst = rand() % 300;
+    uint8_t multicast = 0 == rand() % 8;
+    int op = rand() % 100;
+
+    if (op < 30)
+    {
+      updateEntry(dst, multicast, rand() % 50, rand() % 256);
+    }
+    else if (op < 40)
+    {
+      removeRoute(dst, multicast);
+    }
+    else if (op < 42)
+    {
+      entry = newEntry();
+      entry->dstAddr = dst;
+      entry->multicast = multicast;
+      entry->nextHopAddr = 1;
+    }
+    else if (op < 43)
+    {
+      routeTable()[rand() % NWK_ROUTE_TABLE_SIZE].dstAddr = dst;
+    }
+
+    for (int i = 0; i < NWK_ROUTE_TABLE_SIZE; i++)
+    {
+      if (table[i].dstAddr == dst && table[i].multicast == multicast)
+      {
+        expected = &table[i];
+        break;
+      }
+    }
+
+    // Direct writes may leave several entries with the same key, any of
+    // them is a valid result
+    entry = findEntry(dst, multicast);
+
+    if (entry != expected && !(entry && expected && entry->dstAddr == dst &&
+        entry->multicast == multicast))
+      wrong++;
+
+    if (entry)
+      found++;
+  }
+
+  printf("routeindex: 200000 operations, %d lookups wrong, %d found\n", wrong, found);
+  SIM_CHECK(0 == wrong);
+#endif
+}
+
+/*************************************************************************//**
+  @brief Broadcast jitter resolution and ACK wait accuracy
+*****************************************************************************/
+static void testTimers(void)
+{
+  bool seen[1000] = { false };
+  int distinct = 0, maxDelay = 0;
+  uint32_t start;
+
+  simStart(2);
+
+  for (int i = 0; i < 60; i++)
+  {
+    int delay;
+
+    start = simTime;
+    simNodes[0].lastTxTime = 0;
+    simSend(0, 0xffff, 0, 0, 10);
+
+    while (0 == simNodes[0].lastTxTime && simTime - start < 999)
+      simStep(1);
+
+    delay = simNodes[0].lastTxTime - start;
+
+    if (!seen[delay])
+    {
+      seen[delay] = true;
+      distinct++;
+    }
+
+    if (delay > maxDelay)
+      maxDelay = delay;
+
+    simStep(300);
+  }
+
+  simReset();
+  simNodes[1].setRxState(false);
+  start = simTime;
+  simSend(0, 1, 0, NWK_OPT_ACK_REQUEST, 20);
+  simStep(5000 * (NWK_ACK_RETRIES + 1));
+  SIM_CHECK(simConfirms == 1 && simLastStatus != NWK_SUCCESS_STATUS);
+  printf("timers: %d distinct broadcast delays up to %d ms, no ack after %u ms\n",
+      distinct, maxDelay, simLastConfTime - start);
+}
+
+/*- Tests ------------------------------------------------------------------*/
+static const SimTest_t simTests[] =
+{
+  { "unicast",      testUnicast },
+  { "noack",        testNoAck },
+  { "burst",        testBurst },
+  { "multihop",     testMultihop },
+  { "broadcast",    testBroadcast },
+  { "lossy",        testLossy },
+  { "security",     testSecurity },
+  { "replay",       testReplay },
+  { "storm",        testStorm },
+  { "dense",        testDense },
+  { "fifo",         testFifo },
+  { "dupsources",   testDuplicateSources },
+  { "multipath",    testMultipath },
+  { "foreignpan",   testForeignPan },
+  { "rxlatency",    testRxLatency },
+  { "aggregate",    testAggregate },
+  { "frag",         testFrag },
+  { "blockack",     testBlockAck },
+  { "rto",          testRto },
+  { "retry",        testRetry },
+  { "deferred",     testDeferred },
+  { "congestion",   testCongestion },
+  { "routeindex",   testRouteIndex },
+  { "timers",       testTimers },
+};
+
+/*************************************************************************//**
+  @brief Runs the tests named on the command line, or all of them
+*****************************************************************************/
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    printf("usage: %s <node library> <work directory> [test ...]\n", argv[0]);
+    return 2;
+  }
+
+  setvbuf(stdout, NULL, _IONBF, 0);
+  simLibPath = argv[1];
+  simWorkDir = argv[2];
+
+  for (unsigned i = 0; i < sizeof(simTests) / sizeof(simTests[0]); i++)
+  {
+    bool selected = argc == 3;
+
+    for (int j = 3; j < argc; j++)
+      selected |= 0 == strcmp(argv[j], simTests[i].name);
+
+    if (selected)
+      simTests[i].run();
+  }
+
+  for (int i = 0; i < simNodesAmount; i++)
+    dlclose(simNodes[i].lib);
+
+  printf(simFailures ? "FAILED %d\n" : "ALL PASS\n", simFailures);
+
+  return simFailures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * \file simPhy.c
+ *
+ * \brief Simulated PHY layer and node entry points for the network simulation
+ *
+ * Each simulated node is a separate copy of the stack loaded by sim.c. The
+ * PHY passes outgoing frames to the simulated medium and emulates the
+ * transceiver address filter on reception. The AES engine is replaced by a
+ * keyed mixing function, which is enough for the NWK security code to
+ * detect mismatched keys and tampered frames.
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "phy.h"
+#include "nwk.h"
+#include "sysTimer.h"
+#include "halTimer.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define SIM_PHY_RSSI             -50
+#define SIM_PHY_BROADCAST_ADDR   0xffff
+
+/*- Types ------------------------------------------------------------------*/
+typedef void (*SimMediumTx_t)(void *node, uint8_t *data, uint8_t size);
+
+/*- Prototypes -------------------------------------------------------------*/
+// Only present in the stack when security is enabled
+void PHY_EncryptFrameConf(void) __attribute__((weak));
+
+/*- Variables --------------------------------------------------------------*/
+volatile uint8_t SREG;
+volatile uint8_t halTimerIrqCount;
+
+int simPhyTxCount;
+int simTaskPasses;
+int simTickInterval = HAL_TIMER_INTERVAL;
+bool simPromiscuous; // address filter of the transceiver is off
+
+static SimMediumTx_t simMediumTx;
+static void *simNode;
+static bool simRxState;
+static bool simTxPending;
+static uint16_t simPanId;
+static uint16_t simShortAddr;
+
+static struct
+{
+  bool     pending;
+  uint8_t  *vector;
+  uint8_t  *text;
+  uint8_t  size;
+  uint8_t  *key;
+  bool     encrypt;
+} simAes;
+
+/*- Implementations --------------------------------------------------------*/
+
+void PHY_Init(void) {}
+void PHY_SetChannel(uint8_t channel) { (void)channel; }
+void PHY_SetBand(uint8_t band) { (void)band; }
+void PHY_SetTxPower(uint8_t txPower) { (void)txPower; }
+void PHY_Sleep(void) {}
+void PHY_Wakeup(void) {}
+void PHY_SetRxState(bool rx) { simRxState = rx; }
+void PHY_SetPanId(uint16_t panId) { simPanId = panId; }
+void PHY_SetShortAddr(uint16_t addr) { simShortAddr = addr; }
+uint16_t PHY_RandomReq(void) { return rand(); }
+uint16_t PHY_GetEncryptLatency(void) { return 0; }
+
+/*************************************************************************//**
+  @brief Keyed mixing of a 16 byte block, stands in for AES-128
+*****************************************************************************/
+void PHY_EncryptReq(uint8_t *text, uint8_t *key)
+{
+  for (uint8_t round = 0; round < 4; round++)
+  {
+    for (uint8_t i = 0; i < 16; i++)
+      text[i] = (uint8_t)((text[i] ^ key[(i + round) & 15]) * 167 + 13 + text[(i + 1) & 15]);
+  }
+}
+
+/*************************************************************************//**
+  @brief Starts a CBC-style operation on a frame, completed by the task handler
+*****************************************************************************/
+void PHY_EncryptFrameReq(uint8_t *vector, uint8_t *text, uint8_t size,
+    uint8_t *key, bool encrypt)
+{
+  simAes.vector = vector;
+  simAes.text = text;
+  simAes.size = size;
+  simAes.key = key;
+  simAes.encrypt = encrypt;
+  simAes.pending = true;
+}
+
+/*************************************************************************//**
+  @brief Runs the pending frame encryption request
+*****************************************************************************/
+static void simPhyEncryptFrame(void)
+{
+  do
+  {
+    uint8_t block = simAes.size < 16 ? simAes.size : 16;
+
+    PHY_EncryptReq(simAes.vector, simAes.key);
+
+    for (uint8_t i = 0; i < block; i++)
+    {
+      simAes.text[i] ^= simAes.vector[i];
+
+      if (simAes.encrypt)
+        simAes.vector[i] = simAes.text[i];
+      else
+        simAes.vector[i] ^= simAes.text[i];
+    }
+
+    simAes.text += block;
+    simAes.size -= block;
+  } while (simAes.size > 0);
+
+  simAes.pending = false;
+  PHY_EncryptFrameConf();
+}
+
+/*************************************************************************//**
+  @brief Passes the frame to the medium, the transmission always succeeds
+*****************************************************************************/
+void PHY_DataReq(uint8_t *data, uint8_t size)
+{
+  simPhyTxCount++;
+  simMediumTx(simNode, data, size);
+  simTxPending = true;
+}
+
+/*************************************************************************//**
+  @brief PHY layer task handler
+*****************************************************************************/
+void PHY_TaskHandler(void)
+{
+  if (simAes.pending)
+    simPhyEncryptFrame();
+
+  if (simTxPending)
+  {
+    simTxPending = false;
+    PHY_DataConf(PHY_STATUS_SUCCESS);
+  }
+}
+
+/*************************************************************************//**
+  @brief Initializes the node, @a node is passed back to @a mediumTx
+*****************************************************************************/
+void simNodeInit(void *node, SimMediumTx_t mediumTx)
+{
+  simNode = node;
+  simMediumTx = mediumTx;
+
+  SYS_TimerInit();
+  PHY_Init();
+  NWK_Init();
+}
+
+/*************************************************************************//**
+  @brief One pass of the main loop
+*****************************************************************************/
+void simNodeTask(void)
+{
+  simTaskPasses++;
+  PHY_TaskHandler();
+  NWK_TaskHandler();
+  SYS_TimerTaskHandler();
+}
+
+/*************************************************************************//**
+  @brief Hardware timer interrupt, called every HAL_TIMER_INTERVAL ms
+*****************************************************************************/
+void simNodeTick(void)
+{
+  halTimerIrqCount++;
+}
+
+/*************************************************************************//**
+  @brief Frame received from the medium, filtered like the transceiver does
+         unless simPromiscuous is set
+*****************************************************************************/
+void simNodeRx(uint8_t *data, uint8_t size, uint8_t lqi)
+{
+  PHY_DataInd_t ind = { data, size, lqi, SIM_PHY_RSSI };
+  uint16_t dstPanId = data[3] | (data[4] << 8);
+  uint16_t dstAddr = data[5] | (data[6] << 8);
+
+  if (!simRxState)
+    return;
+
+  if (simPromiscuous)
+  {
+    PHY_DataInd(&ind);
+    return;
+  }
+
+  if (dstPanId != simPanId && dstPanId != SIM_PHY_BROADCAST_ADDR)
+    return;
+
+  if (dstAddr != simShortAddr && dstAddr != SIM_PHY_BROADCAST_ADDR)
+    return;
+
+  PHY_DataInd(&ind);
+}
+
+/*************************************************************************//**
+  @brief Returns the number of resources currently held by the NWK layer
+*****************************************************************************/
+uint16_t simNodeLock(void)
+{
+  return nwkIb.lock;
+}
@@ -0,0 +1,11 @@
+/**
+ * \file eeprom.h
+ *
+ * \brief Host stub, nothing from <avr/eeprom.h> is used by the host build
+ *
+ */
+
+#ifndef _AVR_EEPROM_H_
+#define _AVR_EEPROM_H_
+
+#endif // _AVR_EEPROM_H_
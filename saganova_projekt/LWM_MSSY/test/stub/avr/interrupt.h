@@ -0,0 +1,15 @@
+/**
+ * \file interrupt.h
+ *
+ * \brief Host stub of the AVR interrupt control macros
+ *
+ */
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#define cli() ((void)0)
+#define sei() ((void)0)
+#define ISR(vector) void vector(void); void vector(void)
+
+#endif // _AVR_INTERRUPT_H_
@@ -0,0 +1,15 @@
+/**
+ * \file io.h
+ *
+ * \brief Host stub of the AVR register definitions used by the stack
+ *
+ */
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+#endif // _AVR_IO_H_
@@ -0,0 +1,11 @@
+/**
+ * \file pgmspace.h
+ *
+ * \brief Host stub, nothing from <avr/pgmspace.h> is used by the host build
+ *
+ */
+
+#ifndef _AVR_PGMSPACE_H_
+#define _AVR_PGMSPACE_H_
+
+#endif // _AVR_PGMSPACE_H_
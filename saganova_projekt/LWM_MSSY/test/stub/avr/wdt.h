@@ -0,0 +1,11 @@
+/**
+ * \file wdt.h
+ *
+ * \brief Host stub, nothing from <avr/wdt.h> is used by the host build
+ *
+ */
+
+#ifndef _AVR_WDT_H_
+#define _AVR_WDT_H_
+
+#endif // _AVR_WDT_H_